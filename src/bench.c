@@ -0,0 +1,260 @@
+//******************************************************************************
+// bench.c
+//
+// Northern Arizona University
+//
+// Measures each benchmark in MCLK cycles, SPI bytes, UART bytes and CC2500
+// air time, estimates the energy it costs, and prints one JSON object per
+// line on the UART, e.g.
+//
+//   {"bench":"remote_loop","cycles":51234,"spi":24,"uart":0,
+//    "airtime_us":140007,"energy_uj":4203,"stack":88,"isr_cycles":96}
+//
+// Timer_B runs from SMCLK, which is stopped in LPM3, so the cycle count is
+// CPU time only and sleeping is free. The baseline lives on the host, the
+// output is checked against it by tools/bench_check.py (make bench-check).
+//******************************************************************************
+
+#include <msp430x22x4.h>
+
+#include "bench.h"
+#include "cc2500.h"
+#include "usci_spi.h"
+#include "usci_uart.h"
+#include "stack.h"
+
+unsigned int g_uiBenchISRMax = 0;
+
+static const char * const g_pcaBenchNames[BENCH_COUNT] =
+{
+	"burst_write",
+	"burst_read",
+	"load_profile",
+	"spi_send",
+	"uart_send",
+	"base_loop",
+	"remote_loop",
+	"radio_wake"
+};
+
+// Timer_B overflows, the high word of the cycle counter
+static volatile unsigned int g_uiBenchOverflows = 0;
+
+// State captured by vBench_Start()
+static unsigned char g_ucBench;
+static unsigned long g_ulBenchTicks;
+static unsigned int g_uiBenchSPI;
+static unsigned int g_uiBenchUART;
+
+// Air time accumulated since vBench_Start(), split by direction
+static unsigned long g_ulBenchTXUs;
+static unsigned long g_ulBenchRXUs;
+
+//////////////////////////////////////////////////////////////////////////////
+// ulBench_Ticks()
+//
+// Returns Timer_B extended to 32 bits
+//////////////////////////////////////////////////////////////////////////////
+static unsigned long ulBench_Ticks()
+{
+	unsigned int uiLow;
+	unsigned int uiHigh;
+	unsigned short usState = __get_interrupt_state();
+	
+	__disable_interrupt();
+	uiLow = TBR;
+	uiHigh = g_uiBenchOverflows;
+	
+	// An overflow that hasn't been serviced yet belongs to this reading if
+	// the low word has already wrapped
+	if ((TBCTL & TBIFG) && uiLow < 0x8000)
+	{
+		++uiHigh;
+	}
+	__set_interrupt_state(usState);
+	
+	return ((unsigned long)uiHigh << 16) | uiLow;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vBench_PrintString( pcString ) / vBench_PrintNumber( ulNumber )
+//
+// Minimal output helpers, printf is too big for this part
+//////////////////////////////////////////////////////////////////////////////
+static void vBench_PrintString(const char * pcString)
+{
+	unsigned int uiLength = 0;
+	
+	while (pcString[uiLength])
+	{
+		++uiLength;
+	}
+	vUSCI_A0_UART_SendBytes((unsigned char *)pcString, uiLength);
+}
+
+static void vBench_PrintNumber(unsigned long ulNumber)
+{
+	unsigned char ucaDigits[10];
+	unsigned char ucIndex = sizeof(ucaDigits);
+	
+	do
+	{
+		ucaDigits[--ucIndex] = '0' + (ulNumber % 10);
+		ulNumber /= 10;
+	} while (ulNumber);
+	
+	vUSCI_A0_UART_SendBytes(&ucaDigits[ucIndex], sizeof(ucaDigits) - ucIndex);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vBench_Init()
+//
+// Starts Timer_B counting SMCLK and brings up the UART for the results
+//////////////////////////////////////////////////////////////////////////////
+void vBench_Init()
+{
+	vUSCI_A0_UART_Init();
+	
+	TBCTL = TBSSEL_2 | MC_2 | TBCLR | TBIE;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vBench_Start( ucBench )
+//
+// Starts measuring BENCH
+//////////////////////////////////////////////////////////////////////////////
+void vBench_Start(unsigned char ucBench)
+{
+	g_ucBench = ucBench;
+	g_ulBenchTXUs = 0;
+	g_ulBenchRXUs = 0;
+	g_uiBenchSPI = g_uiUSCI_B0_ByteCount;
+	g_uiBenchUART = g_uiUSCI_A0_TXByteCount;
+	g_uiBenchISRMax = 0;
+	g_ulBenchTicks = ulBench_Ticks();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vBench_AddAirtime( ucLength, ucTX )
+//
+// Adds the air time of a packet with length byte LENGTH. TX is nonzero if
+// it was sent, zero if received.
+//////////////////////////////////////////////////////////////////////////////
+void vBench_AddAirtime(unsigned char ucLength, unsigned char ucTX)
+{
+	unsigned long ulUs = (unsigned long)(ucLength + 1 + BENCH_PACKET_OVERHEAD) *
+	                     BENCH_BYTE_US;
+	if (ucTX)
+	{
+		g_ulBenchTXUs += ulUs;
+	}
+	else
+	{
+		g_ulBenchRXUs += ulUs;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vBench_Stop()
+//
+// Ends the running benchmark and prints its JSON line
+//////////////////////////////////////////////////////////////////////////////
+void vBench_Stop()
+{
+	unsigned long ulCycles = (ulBench_Ticks() - g_ulBenchTicks) * 4;
+	unsigned int uiSPI = g_uiUSCI_B0_ByteCount - g_uiBenchSPI;
+	unsigned int uiUART = g_uiUSCI_A0_TXByteCount - g_uiBenchUART;
+	unsigned long ulEnergy;
+	
+	// E[uJ] = P[uW] * t[us] / 1e6, done as (P / 10 uW) * (t / 100 us) / 1000
+	// to stay inside 32 bits
+	ulEnergy = (((unsigned long)BENCH_VCC_MV * BENCH_MCU_UA / 10000) *
+	            (ulCycles / 16 / 100) +
+	            ((unsigned long)BENCH_VCC_MV * BENCH_TX_UA / 10000) *
+	            (g_ulBenchTXUs / 100) +
+	            ((unsigned long)BENCH_VCC_MV * BENCH_RX_UA / 10000) *
+	            (g_ulBenchRXUs / 100)) / 1000;
+	
+	vBench_PrintString("{\"bench\":\"");
+	vBench_PrintString(g_pcaBenchNames[g_ucBench]);
+	vBench_PrintString("\",\"cycles\":");
+	vBench_PrintNumber(ulCycles);
+	vBench_PrintString(",\"spi\":");
+	vBench_PrintNumber(uiSPI);
+	vBench_PrintString(",\"uart\":");
+	vBench_PrintNumber(uiUART);
+	vBench_PrintString(",\"airtime_us\":");
+	vBench_PrintNumber(g_ulBenchTXUs + g_ulBenchRXUs);
+	vBench_PrintString(",\"energy_uj\":");
+	vBench_PrintNumber(ulEnergy);
+	vBench_PrintString(",\"stack\":");
+	vBench_PrintNumber(uiStack_HighWater());
+	vBench_PrintString(",\"isr_cycles\":");
+	vBench_PrintNumber((unsigned long)g_uiBenchISRMax * 4);
+	vBench_PrintString("}\r\n");
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vBench_RunDrivers()
+//
+// Benchmarks the driver calls one at a time. Registers are read back and
+// written with the same values, and the profile is reloaded, so the radio is
+// left configured and in IDLE. Run before the role code sets a channel.
+//////////////////////////////////////////////////////////////////////////////
+void vBench_RunDrivers()
+{
+	unsigned char ucaBuffer[16];
+	unsigned char ucIndex;
+	
+	vBench_Start(BENCH_BURST_READ);
+	ucCC2500_BurstReadRegisters(0x00, ucaBuffer, sizeof(ucaBuffer));
+	vBench_Stop();
+	
+	vBench_Start(BENCH_BURST_WRITE);
+	ucCC2500_BurstWriteRegisters(0x00, ucaBuffer, sizeof(ucaBuffer));
+	vBench_Stop();
+	
+	vBench_Start(BENCH_LOAD_PROFILE);
+	vCC2500_LoadProfile(0);
+	vBench_Stop();
+	
+	// Calibrate the channel first so the wake hits the cache, as it does
+	// between samples on a REMOTE
+	vCC2500_SetChannel(g_ucCC2500_Channel);
+	vCC2500_Sleep();
+	vBench_Start(BENCH_RADIO_WAKE);
+	vCC2500_Wake();
+	vBench_Stop();
+	
+	// CSn is high, so the radio ignores these
+	vBench_Start(BENCH_SPI_SEND);
+	vUSCI_B0_SPI_SendBytes(ucaBuffer, 0, sizeof(ucaBuffer));
+	vBench_Stop();
+	
+	// Spaces, so the JSON stream stays valid
+	for (ucIndex = 0; ucIndex < sizeof(ucaBuffer); ++ucIndex)
+	{
+		ucaBuffer[ucIndex] = ' ';
+	}
+	vBench_Start(BENCH_UART_SEND);
+	vUSCI_A0_UART_SendBytes(ucaBuffer, sizeof(ucaBuffer));
+	vBench_Stop();
+}
+
+//**************************************************************************/
+// TIMERB1 Interrupt Service Routine
+// Counts Timer_B overflows for ulBench_Ticks()
+//**************************************************************************/
+
+#pragma vector = TIMERB1_VECTOR
+__interrupt void vBench_TimerB1_ISR (void)
+{
+	switch (__even_in_range(TBIV, 14))
+	{
+		case 14:
+			++g_uiBenchOverflows;
+			break;
+		default:
+			break;
+	}
+}
@@ -0,0 +1,54 @@
+//******************************************************************************
+// bench.h
+//
+// Northern Arizona University
+//
+// On-target micro-benchmarks for the radio and UART drivers and for one pass
+// of the BASE and REMOTE loops. Only used when BENCHMARK is defined in main.c
+//******************************************************************************
+
+#ifndef _BENCH_H_
+  #define _BENCH_H_
+
+  void vBench_Init();
+  void vBench_Start(unsigned char ucBench);
+  void vBench_Stop();
+  void vBench_AddAirtime(unsigned char ucLength, unsigned char ucTX);
+  void vBench_RunDrivers();
+
+  // Longest run of a timed ISR during the running benchmark, in Timer_B
+  // ticks. BENCH_ISR_START() goes with the declarations at the top of the
+  // ISR and BENCH_ISR_END() at the bottom; the entry and exit of the ISR
+  // itself (about 11 cycles) aren't counted.
+  extern unsigned int g_uiBenchISRMax;
+  #define    BENCH_ISR_START()    unsigned int uiBenchISR = TBR
+  #define    BENCH_ISR_END()      if ((unsigned int)(TBR - uiBenchISR) >    \
+                                      g_uiBenchISRMax)                      \
+                                  {                                         \
+                                      g_uiBenchISRMax = TBR - uiBenchISR;   \
+                                  }
+
+  // Benchmarks
+  #define    BENCH_BURST_WRITE     0
+  #define    BENCH_BURST_READ      1
+  #define    BENCH_LOAD_PROFILE    2
+  #define    BENCH_SPI_SEND        3
+  #define    BENCH_UART_SEND       4
+  #define    BENCH_BASE_LOOP       5
+  #define    BENCH_REMOTE_LOOP     6
+  #define    BENCH_RADIO_WAKE      7
+  #define    BENCH_COUNT           8
+
+  // Supply and currents used for the energy estimate (CC2500 and
+  // MSP430F2274 datasheets, 3 V, 16 MHz, 1.2 kBaud)
+  #define    BENCH_VCC_MV          3000
+  #define    BENCH_MCU_UA          4400
+  #define    BENCH_TX_UA           21200
+  #define    BENCH_RX_UA           15400
+
+  // Air time of one byte at 1.2 kBaud, and the bytes every packet carries on
+  // top of the FIFO contents (4 preamble, 2 sync, 2 CRC)
+  #define    BENCH_BYTE_US         6667
+  #define    BENCH_PACKET_OVERHEAD 8
+
+#endif /*_BENCH_H_*/
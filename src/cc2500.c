@@ -15,6 +15,59 @@
 
 #include "usci_spi.h"
 
+// Radio state as decoded from the status byte of the last SPI transaction.
+// The FIFO counts saturate at 15 since that is all the status byte holds.
+unsigned char g_ucCC2500_State = STATE_UNKNOWN;
+unsigned char g_ucCC2500_RXBytes = 0;
+unsigned char g_ucCC2500_TXFree = STATUS_FIFO_BYTES;
+
+// Number of SPI transactions (strobes or register reads) skipped because
+// the tracked state made them unnecessary
+unsigned int g_uiCC2500_SPISaved = 0;
+
+// Frequency synthesizer calibration cache. Autocalibration is off in the
+// profile (MCSM0), so every channel is calibrated once with SCAL and the
+// FSCAL3/2/1 results are restored on later switches to that channel.
+unsigned char g_ucaCC2500_CalChannel[CAL_CACHE_SIZE];
+unsigned char g_ucaCC2500_CalFSCAL[CAL_CACHE_SIZE][3];
+unsigned char g_ucCC2500_CalValid = 0;
+unsigned char g_ucCC2500_CalNext = 0;
+unsigned int g_uiCC2500_CalTicks = 0;
+unsigned int g_uiCC2500_CalTemperature = 0;
+unsigned char g_ucCC2500_Channel = 0;
+
+// What has to be put back after SLEEP: the profile in use (for TEST2/1/0)
+// and the PATABLE setting. FSCAL3/2/1 come from the calibration cache.
+unsigned char g_ucCC2500_Profile = 0;
+unsigned char g_ucCC2500_TXPower = 0;
+
+//////////////////////////////////////////////////////////////////////////////
+// vCC2500_TrackStatus(ucStatus, ucRead)
+//
+// Decodes a status byte returned by the radio. READ says whether the header
+// byte had the R/W bit set, in which case the FIFO field is the number of
+// bytes in the RX FIFO, otherwise it is the free space in the TX FIFO.
+//////////////////////////////////////////////////////////////////////////////
+static void vCC2500_TrackStatus(unsigned char ucStatus, unsigned char ucRead)
+{
+	// Status is only valid once the crystal is running
+	if (ucStatus & STATUS_CHIP_RDYn)
+	{
+		g_ucCC2500_State = STATE_UNKNOWN;
+		return;
+	}
+	
+	g_ucCC2500_State = ucStatus & STATUS_STATE;
+	if (ucRead)
+	{
+		g_ucCC2500_RXBytes = ucStatus & STATUS_FIFO_BYTES;
+	}
+	else
+	{
+		g_ucCC2500_TXFree = ucStatus & STATUS_FIFO_BYTES;
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////////
 // vCC2500_Init()
 //
@@ -72,6 +125,7 @@ unsigned char ucCC2500_ReadSingleRegister(unsigned char ucAddress,
 	vUSCI_B0_SPI_SendBytes(&ucAddress, pucData, 1);
 	
 	vCC2500_Deselect();
+	vCC2500_TrackStatus(ucAddress, 1);
 	return ucAddress;
 }
 
@@ -87,6 +141,7 @@ unsigned char ucCC2500_BurstReadRegisters(unsigned char ucAddress,
                                           unsigned char * pucData,
                                           unsigned char ucCount)
 {
+	unsigned char ucOriginal = ucAddress;
 	vCC2500_Select();
 	
 	ucAddress |= 0xC0;
@@ -94,6 +149,14 @@ unsigned char ucCC2500_BurstReadRegisters(unsigned char ucAddress,
 	vUSCI_B0_SPI_SendBytes(pucData, pucData, ucCount);
 	
 	vCC2500_Deselect();
+	vCC2500_TrackStatus(ucAddress, 1);
+	
+	// The status byte was clocked out before the FIFO was read
+	if ((ucAddress & STATUS_CHIP_RDYn) == 0 && ucOriginal == RX_FIFO)
+	{
+		g_ucCC2500_RXBytes = (g_ucCC2500_RXBytes > ucCount) ?
+		                     (g_ucCC2500_RXBytes - ucCount) : 0;
+	}
 	return ucAddress;
 }
 
@@ -114,6 +177,7 @@ unsigned char ucCC2500_WriteSingleRegister(unsigned char ucAddress,
 	vUSCI_B0_SPI_SendBytes(&ucData, &ucAddress, 1);
 	
 	vCC2500_Deselect();
+	vCC2500_TrackStatus(ucAddress, 0);
 	return ucAddress;
 }
 
@@ -126,9 +190,10 @@ unsigned char ucCC2500_WriteSingleRegister(unsigned char ucAddress,
 // Function returns the status byte of the radio
 //////////////////////////////////////////////////////////////////////////////
 unsigned char ucCC2500_BurstWriteRegisters(unsigned char ucAddress,
-                                           unsigned char * pucData,
+                                           const unsigned char * pucData,
                                            unsigned char ucCount)
 {
+	unsigned char ucOriginal = ucAddress;
 	vCC2500_Select();
 	
 	ucAddress |= 0x40;
@@ -136,6 +201,13 @@ unsigned char ucCC2500_BurstWriteRegisters(unsigned char ucAddress,
 	vUSCI_B0_SPI_SendBytes(pucData, 0, ucCount);
 	
 	vCC2500_Deselect();
+	vCC2500_TrackStatus(ucAddress, 0);
+	
+	if ((ucAddress & STATUS_CHIP_RDYn) == 0 && ucOriginal == TX_FIFO)
+	{
+		g_ucCC2500_TXFree = (g_ucCC2500_TXFree > ucCount) ?
+		                    (g_ucCC2500_TXFree - ucCount) : 0;
+	}
 	return ucAddress;
 }
 
@@ -148,13 +220,49 @@ unsigned char ucCC2500_BurstWriteRegisters(unsigned char ucAddress,
 //////////////////////////////////////////////////////////////////////////////
 unsigned char ucCC2500_SendCommandStrobe(unsigned char ucStrobe)
 {
+	unsigned char ucStatus = ucStrobe | 0x80;
 	vCC2500_Select();
 	
-	ucStrobe |= 0x80;
-	vUSCI_B0_SPI_SendBytes(&ucStrobe, &ucStrobe, 1);
+	vUSCI_B0_SPI_SendBytes(&ucStatus, &ucStatus, 1);
 	
 	vCC2500_Deselect();
-	return ucStrobe;
+	vCC2500_TrackStatus(ucStatus, 1);
+	
+	// The status byte shows the state before the strobe took effect, so
+	// move the tracker to where the strobe is taking the radio
+	switch (ucStrobe)
+	{
+		case SIDLE:
+			g_ucCC2500_State = STATE_IDLE;
+			break;
+		case SCAL:
+			g_ucCC2500_State = STATE_CALIBRATE;
+			break;
+		case SFRX:
+			g_ucCC2500_State = STATE_IDLE;
+			g_ucCC2500_RXBytes = 0;
+			break;
+		case SFTX:
+			g_ucCC2500_State = STATE_IDLE;
+			g_ucCC2500_TXFree = STATUS_FIFO_BYTES;
+			break;
+		case SRX:
+			g_ucCC2500_State = STATE_RX;
+			break;
+		case STX:
+			g_ucCC2500_State = STATE_TX;
+			break;
+		case SPWD:
+			// Goes to SLEEP once CSn is high, which it now is
+			g_ucCC2500_State = STATE_SLEEP;
+			break;
+		case SNOP:
+			break;
+		default:
+			g_ucCC2500_State = STATE_UNKNOWN;
+			break;
+	}
+	return ucStatus;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -171,6 +279,7 @@ unsigned char ucCC2500_GetReadStatus()
 	vUSCI_B0_SPI_SendBytes(&ucAddress, &ucAddress, 1);
 	
 	vCC2500_Deselect();
+	vCC2500_TrackStatus(ucAddress, 1);
 	return ucAddress;
 }
 
@@ -188,6 +297,7 @@ unsigned char ucCC2500_GetWriteStatus()
 	vUSCI_B0_SPI_SendBytes(&ucAddress, &ucAddress, 1);
 	
 	vCC2500_Deselect();
+	vCC2500_TrackStatus(ucAddress, 0);
 	return ucAddress;
 }
 
@@ -198,6 +308,7 @@ unsigned char ucCC2500_GetWriteStatus()
 //////////////////////////////////////////////////////////////////////////////
 void vCC2500_SetTXPower(unsigned char ucPower)
 {
+	g_ucCC2500_TXPower = ucPower;
 	ucCC2500_WriteSingleRegister(PATABLE, ucPower);
 }
 
@@ -218,26 +329,20 @@ void vCC2500_SetupRFPacketMode()
 	ucCC2500_WriteSingleRegister(PKTLEN,   0x3D);
 }
 
-//////////////////////////////////////////////////////////////////////////////
-// vCC2500_LoadProfile( ucProfile)
-//
-// Loads the profile specified by PROFILE into the CC2500
-/////////////////////////////////////////////////////////////////////////////
-void vCC2500_LoadProfile(unsigned char ucProfile)
+// Register settings for each profile, kept in flash. Every register from
+// IOCFG2 (0x00) to TEST0 (0x2E) in order.
+static const unsigned char g_ucaCC2500_Profiles[][0x2F] =
 {
-	unsigned char ucAddress;
-  unsigned char ucaProfiles[][0x2F] = 
-	{
     { // 1.2 kBaud, 28 kHz Deviation, 2-FSK, 203 kHz RX filterbandwidth,
-      0x29,  // GDO2 output pin configuration.
+      0x07,  // GDO2 output pin configuration (CRC OK).
       0x2E,  // GDO1 output pin configuration.
       0x06,  // GDO0 output pin configuration.
       0x07,  // RXFIFO and TXFIFO thresholds.
       0xD3,  // Sync word, high byte
       0x91,  // Sync word, low byte
-      0x20,  // Packet length.
-      0x08,  // Packet automation control.
-      0x04,  // Packet automation control.
+      0x3D,  // Packet length (max, first byte in the FIFO is the length).
+      0x0C,  // Packet automation control (append RSSI and LQI).
+      0x05,  // Packet automation control (variable length).
       0x00,  // Device address.
       0x80,  // Channel number.
       0x08,  // Frequency synthesizer control.
@@ -252,8 +357,8 @@ void vCC2500_LoadProfile(unsigned char ucProfile)
       0xF8,  // Modem configuration.
       0x44,  // Modem deviation setting (when FSK modulation is enabled).
       0x07,  // Main Radio Control State Machine configuration
-      0x30,  // Main Radio Control State Machine configuration
-      0x18,  // Main Radio Control State Machine configuration.
+      0x33,  // Main Radio Control State Machine configuration (RX after TX)
+      0x08,  // Main Radio Control State Machine configuration (no autocal).
       0x16,  // Frequency Offset Compensation Configuration.
       0x6C,  // Bit synchronization Configuration.
       0x03,  // AGC control.
@@ -277,7 +382,18 @@ void vCC2500_LoadProfile(unsigned char ucProfile)
       0x31,  // Various test settings.
       0x0B  // Various test settings.   
     }
-	};
+};
+
+//////////////////////////////////////////////////////////////////////////////
+// vCC2500_LoadProfile( ucProfile)
+//
+// Loads the profile specified by PROFILE into the CC2500
+/////////////////////////////////////////////////////////////////////////////
+void vCC2500_LoadProfile(unsigned char ucProfile)
+{
+	unsigned char ucAddress;
+	
+	g_ucCC2500_Profile = ucProfile;
 	
 	// Power up the radio and issue the reset command, then wait for reset to 
 	// finish
@@ -287,6 +403,379 @@ void vCC2500_LoadProfile(unsigned char ucProfile)
 	while (P3IN & BIT2);
 	vCC2500_Deselect();
 	
+	// Reset leaves the radio in IDLE with both FIFOs empty
+	g_ucCC2500_State = STATE_IDLE;
+	g_ucCC2500_RXBytes = 0;
+	g_ucCC2500_TXFree = STATUS_FIFO_BYTES;
+	
 	// Write the registers
-	ucCC2500_BurstWriteRegisters(0x00, &ucaProfiles[ucProfile][0], 0x2F);
+	ucCC2500_BurstWriteRegisters(0x00, &g_ucaCC2500_Profiles[ucProfile][0], 0x2F);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// ucCC2500_GetState()
+//
+// Returns the tracked radio state (STATE_xxx) without touching the SPI
+//////////////////////////////////////////////////////////////////////////////
+unsigned char ucCC2500_GetState()
+{
+	return g_ucCC2500_State;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// ucCC2500_GetRXBytes()
+//
+// Returns the tracked number of bytes in the RX FIFO (saturates at 15)
+//////////////////////////////////////////////////////////////////////////////
+unsigned char ucCC2500_GetRXBytes()
+{
+	return g_ucCC2500_RXBytes;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vCC2500_EnterIdle()
+//
+// Puts the radio in IDLE, the strobe is skipped if it is already there
+//////////////////////////////////////////////////////////////////////////////
+void vCC2500_EnterIdle()
+{
+	if (g_ucCC2500_State == STATE_IDLE)
+	{
+		++g_uiCC2500_SPISaved;
+		return;
+	}
+	ucCC2500_SendCommandStrobe(SIDLE);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vCC2500_EnterRX()
+//
+// Puts the radio in RX with an empty RX FIFO using as few strobes as the
+// tracked state allows. SFRX is only legal in IDLE or RXFIFO_OVERFLOW, so
+// anything else goes through IDLE first.
+//////////////////////////////////////////////////////////////////////////////
+void vCC2500_EnterRX()
+{
+	switch (g_ucCC2500_State)
+	{
+		case STATE_RX:
+			++g_uiCC2500_SPISaved;
+			return;
+		case STATE_RXFIFO_OVERFLOW:
+			ucCC2500_SendCommandStrobe(SFRX);
+			break;
+		case STATE_TXFIFO_UNDERFLOW:
+			ucCC2500_SendCommandStrobe(SFTX);
+			break;
+		case STATE_IDLE:
+			break;
+		default:
+			ucCC2500_SendCommandStrobe(SIDLE);
+			break;
+	}
+	
+	// Only flush if something was left behind in the FIFO
+	if (g_ucCC2500_RXBytes)
+	{
+		ucCC2500_SendCommandStrobe(SFRX);
+	}
+	else
+	{
+		++g_uiCC2500_SPISaved;
+	}
+	ucCC2500_SendCommandStrobe(SRX);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vCC2500_PrepareTX()
+//
+// Makes sure the TX FIFO is empty before a packet is written to it. The SFTX
+// is only sent if the tracker shows an underflow or leftover bytes.
+//////////////////////////////////////////////////////////////////////////////
+void vCC2500_PrepareTX()
+{
+	if (g_ucCC2500_State == STATE_IDLE &&
+	    g_ucCC2500_TXFree == STATUS_FIFO_BYTES)
+	{
+		++g_uiCC2500_SPISaved;
+		return;
+	}
+	
+	if (g_ucCC2500_State != STATE_IDLE &&
+	    g_ucCC2500_State != STATE_TXFIFO_UNDERFLOW)
+	{
+		ucCC2500_SendCommandStrobe(SIDLE);
+	}
+	ucCC2500_SendCommandStrobe(SFTX);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vCC2500_EnterTX()
+//
+// Sends the packet in the TX FIFO, the FIFO must be loaded first
+//////////////////////////////////////////////////////////////////////////////
+void vCC2500_EnterTX()
+{
+	ucCC2500_SendCommandStrobe(STX);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vCC2500_TrackPacketEnd( ucRXBytes )
+//
+// Call from the GDO0 end of packet interrupt. MCSM1 sends the radio to IDLE
+// after RX and straight to RX after TX, so the tracker can be updated without
+// reading MARCSTATE or RXBYTES. RXBYTES is what is now in the RX FIFO: the
+// packet length after a good RX, 0 after a TX or a CRC failure (autoflush).
+//////////////////////////////////////////////////////////////////////////////
+void vCC2500_TrackPacketEnd(unsigned char ucRXBytes)
+{
+	if (g_ucCC2500_State == STATE_TX)
+	{
+		g_ucCC2500_TXFree = STATUS_FIFO_BYTES;
+		g_ucCC2500_State = STATE_RX;
+	}
+	else
+	{
+		g_ucCC2500_State = STATE_IDLE;
+	}
+	g_ucCC2500_RXBytes = ucRXBytes;
+	++g_uiCC2500_SPISaved;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vCC2500_Calibrate()
+//
+// Runs a manual FS calibration on the current channel and stores the result
+// in cache entry ENTRY. The radio is left in IDLE.
+//////////////////////////////////////////////////////////////////////////////
+static void vCC2500_Calibrate(unsigned char ucEntry)
+{
+	vCC2500_EnterIdle();
+	ucCC2500_SendCommandStrobe(SCAL);
+	
+	// Calibration takes about 700 us, the radio goes back to IDLE when done
+	while (g_ucCC2500_State != STATE_IDLE)
+	{
+		ucCC2500_GetReadStatus();
+	}
+	
+	ucCC2500_BurstReadRegisters(FSCAL3, g_ucaCC2500_CalFSCAL[ucEntry], 3);
+	g_ucaCC2500_CalChannel[ucEntry] = g_ucCC2500_Channel;
+	g_ucCC2500_CalValid |= (1 << ucEntry);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vCC2500_RestoreCalibration()
+//
+// Writes the cached FSCAL3/2/1 for the current channel back in one burst,
+// or calibrates it if it isn't cached. The radio must be in IDLE.
+//////////////////////////////////////////////////////////////////////////////
+static void vCC2500_RestoreCalibration()
+{
+	unsigned char ucEntry;
+	
+	for (ucEntry = 0; ucEntry < CAL_CACHE_SIZE; ++ucEntry)
+	{
+		if ((g_ucCC2500_CalValid & (1 << ucEntry)) &&
+		    g_ucaCC2500_CalChannel[ucEntry] == g_ucCC2500_Channel)
+		{
+			ucCC2500_BurstWriteRegisters(FSCAL3, g_ucaCC2500_CalFSCAL[ucEntry], 3);
+			return;
+		}
+	}
+	
+	vCC2500_Calibrate(g_ucCC2500_CalNext);
+	g_ucCC2500_CalNext = (g_ucCC2500_CalNext + 1) % CAL_CACHE_SIZE;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vCC2500_SetChannel( ucChannel )
+//
+// Switches to CHANNEL. If the channel has been calibrated before, the cached
+// FSCAL3/2/1 values are written back in one burst instead of running SCAL
+// again. The radio is left in IDLE.
+//////////////////////////////////////////////////////////////////////////////
+void vCC2500_SetChannel(unsigned char ucChannel)
+{
+	vCC2500_EnterIdle();
+	g_ucCC2500_Channel = ucChannel;
+	ucCC2500_WriteSingleRegister(CHANNR, ucChannel);
+	vCC2500_RestoreCalibration();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vCC2500_InvalidateCalibration()
+//
+// Drops every cached calibration and recalibrates the current channel. The
+// radio is left in IDLE.
+//////////////////////////////////////////////////////////////////////////////
+void vCC2500_InvalidateCalibration()
+{
+	g_ucCC2500_CalValid = 0;
+	g_ucCC2500_CalNext = 1 % CAL_CACHE_SIZE;
+	g_uiCC2500_CalTicks = 0;
+	vCC2500_Calibrate(0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vCC2500_CalibrationTick()
+//
+// Call once per sample period. Every CAL_INTERVAL_TICKS calls the cache is
+// thrown out and the synthesizer recalibrated for drift, which leaves the
+// radio in IDLE.
+//////////////////////////////////////////////////////////////////////////////
+void vCC2500_CalibrationTick()
+{
+	if (++g_uiCC2500_CalTicks >= CAL_INTERVAL_TICKS)
+	{
+		vCC2500_InvalidateCalibration();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vCC2500_CalibrationTemperature( uiTemperature )
+//
+// Feed the latest temperature reading (any unit, e.g. raw ADC10 counts of
+// the internal sensor). The cache is recalibrated if it has moved by more
+// than CAL_TEMPERATURE_DELTA since the last calibration, which leaves the
+// radio in IDLE.
+//////////////////////////////////////////////////////////////////////////////
+void vCC2500_CalibrationTemperature(unsigned int uiTemperature)
+{
+	unsigned int uiDelta;
+	
+	uiDelta = (uiTemperature > g_uiCC2500_CalTemperature) ?
+	          (uiTemperature - g_uiCC2500_CalTemperature) :
+	          (g_uiCC2500_CalTemperature - uiTemperature);
+	
+	if (uiDelta > CAL_TEMPERATURE_DELTA)
+	{
+		g_uiCC2500_CalTemperature = uiTemperature;
+		vCC2500_InvalidateCalibration();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vCC2500_Sleep()
+//
+// Puts the radio in SLEEP, where it draws well under 1 uA instead of the
+// 1.5 mA of IDLE. Use vCC2500_Wake() before talking to it again.
+//////////////////////////////////////////////////////////////////////////////
+void vCC2500_Sleep()
+{
+	vCC2500_EnterIdle();
+	ucCC2500_SendCommandStrobe(SPWD);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vCC2500_Wake()
+//
+// Wakes the radio from SLEEP and puts back what SLEEP loses, without the
+// SRES and full profile load: TEST2/1/0 in one burst, the PATABLE, and
+// FSCAL3/2/1 from the calibration cache. The other registers are retained.
+// The radio is left in IDLE.
+//////////////////////////////////////////////////////////////////////////////
+void vCC2500_Wake()
+{
+	if (g_ucCC2500_State != STATE_SLEEP)
+	{
+		return;
+	}
+	
+	// Taking CSn low wakes the radio, vCC2500_Select() waits for SO to go
+	// low, which means the crystal is running again
+	vCC2500_Select();
+	vCC2500_Deselect();
+	
+	// The FIFOs don't survive SLEEP either
+	g_ucCC2500_State = STATE_IDLE;
+	g_ucCC2500_RXBytes = 0;
+	g_ucCC2500_TXFree = STATUS_FIFO_BYTES;
+	
+	ucCC2500_BurstWriteRegisters(TEST2,
+	                             &g_ucaCC2500_Profiles[g_ucCC2500_Profile][TEST2],
+	                             3);
+	ucCC2500_WriteSingleRegister(PATABLE, g_ucCC2500_TXPower);
+	vCC2500_RestoreCalibration();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// cCC2500_ReadRSSI()
+//
+// Reads the RSSI status register. The value is in 0.5 dB steps with a -72 dB
+// offset (RSSI_dBm = RSSI / 2 - 72), so raw values compare directly.
+//////////////////////////////////////////////////////////////////////////////
+signed char cCC2500_ReadRSSI()
+{
+	unsigned char ucRSSI;
+	
+	// Status registers have to be read with the burst bit set
+	ucCC2500_BurstReadRegisters(RSSI, &ucRSSI, 1);
+	return (signed char)ucRSSI;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// cCC2500_ScanChannel( ucChannel )
+//
+// Listens on CHANNEL and returns the highest RSSI out of RSSI_SAMPLES
+// readings. The radio is left in IDLE on that channel with the RX FIFO
+// flushed, since a packet heard during the scan is not for the caller.
+//////////////////////////////////////////////////////////////////////////////
+signed char cCC2500_ScanChannel(unsigned char ucChannel)
+{
+	unsigned char ucSample;
+	signed char cRSSI;
+	signed char cMax = -128;
+	
+	vCC2500_SetChannel(ucChannel);
+	vCC2500_EnterRX();
+	
+	// Give the AGC time to settle before the RSSI is valid
+	__delay_cycles(16000);
+	
+	for (ucSample = 0; ucSample < RSSI_SAMPLES; ++ucSample)
+	{
+		cRSSI = cCC2500_ReadRSSI();
+		if (cRSSI > cMax)
+		{
+			cMax = cRSSI;
+		}
+		__delay_cycles(1600);
+	}
+	
+	vCC2500_EnterIdle();
+	ucCC2500_SendCommandStrobe(SFRX);
+	return cMax;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// ucCC2500_FindClearChannel( pucChannels, ucCount, pcRSSI)
+//
+// Scans the COUNT channels in CHANNELS and returns the index of the quietest
+// one. The RSSI of every channel is stored in RSSI if it is not 0. The radio
+// is left in IDLE on the last channel scanned.
+//////////////////////////////////////////////////////////////////////////////
+unsigned char ucCC2500_FindClearChannel(const unsigned char * pucChannels,
+                                        unsigned char ucCount,
+                                        signed char * pcRSSI)
+{
+	unsigned char ucIndex;
+	unsigned char ucBest = 0;
+	signed char cRSSI;
+	signed char cBest = 127;
+	
+	for (ucIndex = 0; ucIndex < ucCount; ++ucIndex)
+	{
+		cRSSI = cCC2500_ScanChannel(pucChannels[ucIndex]);
+		if (pcRSSI)
+		{
+			pcRSSI[ucIndex] = cRSSI;
+		}
+		if (cRSSI < cBest)
+		{
+			cBest = cRSSI;
+			ucBest = ucIndex;
+		}
+	}
+	return ucBest;
 }
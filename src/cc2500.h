@@ -25,7 +25,7 @@
                                              unsigned char ucData);
   
   unsigned char ucCC2500_BurstWriteRegisters(unsigned char ucAddress,
-                                             unsigned char * pucData,
+                                             const unsigned char * pucData,
                                              unsigned char ucCount);
   
   unsigned char ucCC2500_SendCommandStrobe(unsigned char ucStrobe);
@@ -36,6 +36,49 @@
   void vCC2500_SetupRFPacketMode();
   void vCC2500_LoadProfile(unsigned char ucProfile);
   
+  // Radio state tracking, see cc2500.c
+  unsigned char ucCC2500_GetState();
+  unsigned char ucCC2500_GetRXBytes();
+  void vCC2500_EnterIdle();
+  void vCC2500_EnterRX();
+  void vCC2500_EnterTX();
+  void vCC2500_PrepareTX();
+  void vCC2500_TrackPacketEnd(unsigned char ucRXBytes);
+  
+  extern unsigned char g_ucCC2500_State;
+  extern unsigned char g_ucCC2500_RXBytes;
+  extern unsigned char g_ucCC2500_TXFree;
+  extern unsigned int g_uiCC2500_SPISaved;
+  
+  // Frequency synthesizer calibration cache, see cc2500.c
+  void vCC2500_SetChannel(unsigned char ucChannel);
+  void vCC2500_InvalidateCalibration();
+  void vCC2500_CalibrationTick();
+  void vCC2500_CalibrationTemperature(unsigned int uiTemperature);
+  
+  // Number of channels whose calibration is kept (max 8)
+  #define    CAL_CACHE_SIZE         8
+  // Calibration is redone every this many ticks (~5 min at 1 Hz)
+  #define    CAL_INTERVAL_TICKS     300
+  // Temperature change that forces a recalibration (ADC10 counts)
+  #define    CAL_TEMPERATURE_DELTA  20
+  
+  extern unsigned char g_ucCC2500_Channel;
+  
+  // Radio SLEEP between packets, see cc2500.c
+  void vCC2500_Sleep();
+  void vCC2500_Wake();
+  
+  // Clear channel assessment, see cc2500.c
+  signed char cCC2500_ReadRSSI();
+  signed char cCC2500_ScanChannel(unsigned char ucChannel);
+  unsigned char ucCC2500_FindClearChannel(const unsigned char * pucChannels,
+                                          unsigned char ucCount,
+                                          signed char * pcRSSI);
+  
+  // RSSI readings taken per channel during a scan
+  #define    RSSI_SAMPLES           8
+  
   // Register addresses
   #define    IOCFG2    0x00
   #define    IOCFG1    0x01
@@ -120,6 +163,25 @@
   #define    SWORRST        0x3C
   #define    SNOP           0x3D
   
+  // Status byte fields
+  #define    STATUS_CHIP_RDYn   0x80
+  #define    STATUS_STATE       0x70
+  #define    STATUS_FIFO_BYTES  0x0F
+  
+  // Values of the STATE field in the status byte
+  #define    STATE_IDLE              0x00
+  #define    STATE_RX                0x10
+  #define    STATE_TX                0x20
+  #define    STATE_FSTXON            0x30
+  #define    STATE_CALIBRATE         0x40
+  #define    STATE_SETTLING          0x50
+  #define    STATE_RXFIFO_OVERFLOW   0x60
+  #define    STATE_TXFIFO_UNDERFLOW  0x70
+  // Not chip states. The radio can't answer in SLEEP, and the tracker uses
+  // UNKNOWN when the state can't be known.
+  #define    STATE_SLEEP             0xFE
+  #define    STATE_UNKNOWN           0xFF
+  
   // PATABLE values
   #define    POS_01_DBM     0xFF
   #define    ZERO_DBM       0xFE
@@ -22,29 +22,1236 @@
 #include "usci_spi.h"
 #include "usci_uart.h"
 #include "cc2500.h"
+#include "packet.h"
+#include "record.h"
+#include "bench.h"
+#include "stack.h"
 #include "eZ430-RF2500_LED.h"
 
 //******************************************************************************
 // Global variables
 //******************************************************************************
 
-// Holds value from ADC10MEM - split in two
-unsigned char g_ucaRXInput[2];
-
-// The value that is retrieved from the ADC10MEM - only ten bits
-unsigned int g_uiSolar;
+// Packet being sent and last packet received, see packet.h for the layout
+unsigned char g_ucaTXPacket[PKT_BUFFER_SIZE];
+unsigned char g_ucaRXPacket[PKT_BUFFER_SIZE];
 
 // Flag for whether or not the device is receiving or sending data with CC2500
 unsigned char g_ucRXFlag = 0;
 
+// Set by the PORT2 ISR when the received packet passed the CRC check
+unsigned char g_ucRXPacketOK = 0;
+
+// Set by the ISRs to say why the CPU was woken up, see ucSleepUntil()
+volatile unsigned char g_ucWakeEvents = 0;
+
+#define WAKE_TIMER    BIT0
+#define WAKE_ADC      BIT1
+#define WAKE_RADIO    BIT2
+#define WAKE_TIMEOUT  BIT3
+#define WAKE_UART     BIT4
+
+// Channels the BASE picks from and the REMOTEs search when the link is lost.
+// Spread across the band so at least one sits between the Wi-Fi channels.
+#define CHANNEL_COUNT    8
+#define DEFAULT_CHANNEL  0x83
+const unsigned char g_ucaChannels[CHANNEL_COUNT] =
+	{ 0x03, 0x23, 0x43, 0x63, 0x83, 0xA3, 0xC3, 0xE3 };
+
 
 
 //******************************************************************************
 // Define MSP430 functionality: BASE or REMOTE
 //******************************************************************************
 
+// The Makefile passes the role on the command line (-DBASE or -DREMOTE), so
+// each image only holds its own code, ISRs and buffers. A build without one,
+// e.g. from the IDE, is a BASE.
+#if !defined(BASE) && !defined(REMOTE)
 #define BASE
-//#define REMOTE
+#endif
+#if defined(BASE) && defined(REMOTE)
+#error "Define BASE or REMOTE, not both"
+#endif
+
+// Define as well as BASE or REMOTE to print driver and loop benchmarks as
+// JSON on the UART, see bench.c (make BENCHMARK=1)
+//#define BENCHMARK
+
+// Define as well as REMOTE to watch for transients between samples and send
+// them to the BASE, see vCaptureUntilTimer() (make CAPTURE=1)
+//#define CAPTURE
+
+// Only a REMOTE has anything to capture
+#ifndef REMOTE
+#undef CAPTURE
+#endif
+
+
+#ifdef BASE
+
+// Packets between RSSI sweeps of the candidate channels
+#define SCAN_INTERVAL       600
+
+// A channel must be this much quieter (0.5 dB steps) to be worth moving to
+#define CHANNEL_HYSTERESIS  12
+
+// Number of ACKs that announce a new channel before the BASE moves to it
+#define CHANNEL_ANNOUNCE    30
+
+// Channel handed out in every ACK and how many more ACKs will announce it
+unsigned char g_ucNextChannel = DEFAULT_CHANNEL;
+unsigned char g_ucAnnounce = 0;
+
+unsigned int g_uiScanCountdown = SCAN_INTERVAL;
+
+// RSSI of each candidate channel from the last sweep
+signed char g_caChannelRSSI[CHANNEL_COUNT];
+
+// Packets dropped for a bad CRC
+unsigned int g_uiCRCErrors = 0;
+
+// Record being sent to the PC, see record.h for the layout
+unsigned char g_ucaRecord[REC_SAMPLE_LENGTH];
+
+// Timer_A runs continuously on the VLO, the overflows count the high word of
+// the timestamps. The PORT2 ISR latches the time each received packet ends.
+unsigned int g_uiTickOverflows = 0;
+unsigned long g_ulRXTimestamp = 0;
+
+// Command from the PC as it comes in: type, length, payload, checksum.
+// Index is 0 while waiting for REC_SYNC, otherwise bytes stored + 1.
+unsigned char g_ucaCommand[CMD_MAX_LENGTH + 3];
+unsigned char g_ucCommandIndex = 0;
+
+// Set when the PC has picked the channel, stops the automatic moves
+unsigned char g_ucChannelPinned = 0;
+
+// REMOTE configurations waiting to go out in the ACKs. A slot holds the node
+// (0 = free, PKT_BROADCAST = every node without a slot of its own) and the
+// configuration as it is sent: version, period MSB, period LSB, TX power,
+// ADC10SHT_x, capture level / 4, capture slope. The REMOTE ignores a version
+// it already runs. A node's slot is marked done (one bit per slot) once the
+// node reports the version, and can then be given to another node; it is
+// kept until then so the node doesn't fall back to a broadcast configuration.
+// While a broadcast is queued a done slot is kept as well, since giving it
+// away would send that node the broadcast in place of its own configuration.
+#define CONFIG_SLOTS  4
+#define CONFIG_BYTES  7
+unsigned char g_ucaConfigNode[CONFIG_SLOTS];
+unsigned char g_ucaConfig[CONFIG_SLOTS][CONFIG_BYTES];
+unsigned char g_ucConfigDone = 0;
+
+// Waveform record a capture is put back together in, and the fragments that
+// are in so far (one bit each). The record starts with the node and capture
+// number, so a fragment of some other capture is easy to spot.
+unsigned char g_ucaWaveform[REC_WAVEFORM_LENGTH];
+unsigned char g_ucCaptureFragments = 0;
+
+#endif
+
+#ifdef REMOTE
+
+// The value that is retrieved from the ADC10MEM - only ten bits
+unsigned int g_uiSolar;
+
+// Address of this REMOTE, every REMOTE needs its own (make remote NODE_ID=n).
+// PKT_BASE_ADDRESS (0) belongs to the BASE and PKT_BROADCAST to everyone.
+#ifndef NODE_ID
+#define NODE_ID          0x01
+#endif
+#if NODE_ID == PKT_BASE_ADDRESS || NODE_ID >= PKT_BROADCAST
+#error "NODE_ID must be 1 to 254"
+#endif
+
+// Sample period in VLO ticks (about one second). Every period is moved by up
+// to +/- SAMPLE_JITTER / 2 at random so REMOTEs that started together don't
+// keep colliding.
+#define SAMPLE_PERIOD    14000
+#define SAMPLE_JITTER    1024
+
+// Time to wait for the whole ACK after a packet, in VLO ticks. A config ACK
+// is 20 bytes on the air at 1.2 kBaud (133 ms) after the BASE turns around;
+// this is 250 ms, and still 175 ms with the VLO at its fastest (20 kHz)
+#define ACK_TIMEOUT      3500
+
+// Time to wait for the end of a packet whose sync word is already in. The
+// rest of the longest packet (PKT_BUFFER_SIZE bytes) takes 213 ms on the air,
+// 4267 ticks with the VLO at its fastest.
+#define RX_TIMEOUT       4500
+
+// Set once the ACK timeout has been moved on for a packet coming in
+unsigned char g_ucTimeoutMoved = 0;
+
+// The sample periods the BASE lets through (record.h) have to fit the
+// jitter into TACCR0, and a sample (about 2000 ticks on the air) plus the
+// ACK wait into the shortest period
+#if CONFIG_MAX_PERIOD > 0xFFFF - SAMPLE_JITTER / 2
+#error "CONFIG_MAX_PERIOD leaves no room for SAMPLE_JITTER"
+#endif
+#if CONFIG_MIN_PERIOD - SAMPLE_JITTER / 2 < 2000 + ACK_TIMEOUT
+#error "CONFIG_MIN_PERIOD is shorter than a sample and its ACK"
+#endif
+
+// Missed ACKs in a row before the REMOTE starts searching for the BASE
+#define LINK_LOSS_LIMIT  3
+
+unsigned char g_ucMissedAcks = 0;
+unsigned char g_ucHopIndex = 4;
+
+// Channel the BASE has announced it is moving to, 0 if none. Tried first
+// if the link is lost before the ACK that says to move.
+unsigned char g_ucPendingChannel = 0;
+
+// Total ACKs missed, each one is a lost or unconfirmed sample
+unsigned int g_uiAcksMissed = 0;
+
+// Sequence number of the next sample, lets the host count lost packets
+unsigned char g_ucSequence = 0;
+
+// State of the random number generator for the period jitter
+unsigned int g_uiRandom = NODE_ID;
+
+// Configuration set over the air by the BASE, version 0 is the built-in one
+unsigned char g_ucConfigVersion = 0;
+unsigned int g_uiSamplePeriod = SAMPLE_PERIOD;
+
+// Every sample is one CONSEQ_1 sequence from INCH_10 down to A0 behind a
+// single reference warm-up. The DTC stores the results in that order, so
+// channel x ends up in g_uiaADC[ADC_SLOT(x)].
+#define ADC_SEQUENCE     11
+#define ADC_SLOT(x)      (ADC_SEQUENCE - 1 - (x))
+#define ADC_VOLTAGE      0     // A0, panel voltage from the CLIO board
+#define ADC_CURRENT      1     // A1, across the panel current shunt
+#define ADC_TEMPERATURE  10    // internal temperature sensor
+
+// The whole sequence shares one ADC10SHT_x. The temperature sensor needs
+// 30 us of sampling, and on ADC10OSC / 4 only ADC10SHT_3 (64 clocks, 40 us
+// or more) gives it that. With a shorter one from a configuration its
+// reading is off, so it is not used to trigger FS calibrations.
+#define ADC_TEMPERATURE_SHT    ADC10SHT_3
+
+// Panel voltage and current at 1023 counts, set for the divider and shunt
+// on the board
+#define VOLTAGE_FULL_SCALE_MV  2500
+#define CURRENT_FULL_SCALE_MA  250
+
+// The 2.5 V reference needs 30 us to settle, at 16 MHz
+#define REF_SETTLE_CYCLES      480
+
+unsigned int g_uiaADC[ADC_SEQUENCE];
+
+#ifdef CAPTURE
+
+// Triggers in ADC10 counts, 0 turns one off. LEVEL fires when the signal
+// crosses it either way, SLOPE when two samples in a row are that far apart.
+// These are the defaults, the BASE can change them with a configuration.
+#define CAPTURE_LEVEL    512
+#define CAPTURE_SLOPE    64
+unsigned int g_uiCaptureLevel = CAPTURE_LEVEL;
+unsigned int g_uiCaptureSlope = CAPTURE_SLOPE;
+
+// The DTC fills the ring one block at a time, at about 16 kHz with the
+// default ADC10SHT_3. A capture is the block before the one the trigger fired
+// in, that block and the blocks after it, so the whole ring.
+#define CAPTURE_BLOCK    16
+#define CAPTURE_BLOCKS   (PKT_CAPTURE_SAMPLES / CAPTURE_BLOCK)
+
+// Tries for each fragment before the rest of the capture is dropped
+#define CAPTURE_TRIES    3
+
+unsigned int g_uiaCapture[PKT_CAPTURE_SAMPLES];
+
+// Set while the ADC10 runs into the ring. The ISR counts the blocks filled
+// since the start and stops the ADC10 once the count reaches the stop count
+// (0 until a trigger fires).
+volatile unsigned char g_ucCapturing = 0;
+volatile unsigned int g_uiCaptureFilled;
+volatile unsigned int g_uiCaptureStopAt;
+
+// Number of the next capture, lets the BASE tell fragments apart
+unsigned char g_ucCaptureId = 0;
+
+#endif
+
+#endif
+
+
+//******************************************************************************
+// ucSleepUntil( ucEvents )
+//
+// Sleeps in LPM3 until one of the WAKE_xxx bits in EVENTS is set by an ISR.
+// The bits that were set are cleared and returned. Interrupts are disabled
+// while the flags are checked so an event can't slip in before the sleep.
+//******************************************************************************
+
+static unsigned char ucSleepUntil(unsigned char ucEvents)
+{
+	unsigned char ucFired;
+
+	__disable_interrupt();
+	while ( 1 )
+	{
+#ifdef BASE
+		// The UART driver has its own flag
+		if ( g_ucUSCI_A0_RXFlag )
+		{
+			g_ucUSCI_A0_RXFlag = 0;
+			g_ucWakeEvents |= WAKE_UART;
+		}
+#endif
+
+		if ( g_ucWakeEvents & ucEvents )
+		{
+			break;
+		}
+
+		// Sets GIE and the LPM3 bits in one instruction
+		__bis_SR_register( LPM3_bits + GIE );
+		__disable_interrupt();
+	}
+	ucFired = g_ucWakeEvents & ucEvents;
+	g_ucWakeEvents &= ~ucFired;
+	__enable_interrupt();
+
+	return ucFired;
+}
+
+
+//******************************************************************************
+// vSendPacket( pucPacket )
+//
+// Loads the packet (length byte first) into the TX FIFO in one burst and
+// starts sending it. The PORT2 ISR sets WAKE_RADIO when it is gone, after
+// which MCSM1 leaves the radio in RX.
+//******************************************************************************
+
+static void vSendPacket(unsigned char * pucPacket)
+{
+	// Clear the transmit FIFO, skipped if the tracker shows it
+	// emptied properly after the last packet
+	vCC2500_PrepareTX();
+
+	ucCC2500_BurstWriteRegisters(TX_FIFO, pucPacket, pucPacket[PKT_LENGTH] + 1);
+
+#ifdef BENCHMARK
+	vBench_AddAirtime(pucPacket[PKT_LENGTH], 1);
+#endif
+
+	// Send flag
+	g_ucRXFlag = 0;
+	g_ucWakeEvents &= ~WAKE_RADIO;
+
+	// Send strobe command to send the packet
+	vCC2500_EnterTX();
+}
+
+
+//******************************************************************************
+// ucReceivePacket( pucPacket )
+//
+// Reads the packet that the PORT2 ISR flagged out of the RX FIFO, along with
+// the status bytes the radio appended. Returns the length byte, or 0 if the
+// packet does not fit in PKT_BUFFER_SIZE.
+//******************************************************************************
+
+static unsigned char ucReceivePacket(unsigned char * pucPacket)
+{
+	ucCC2500_BurstReadRegisters(RX_FIFO, &pucPacket[PKT_LENGTH], 1);
+
+	if ( pucPacket[PKT_LENGTH] == 0 ||
+	     pucPacket[PKT_LENGTH] >= PKT_BUFFER_SIZE - PKT_STATUS_LENGTH )
+	{
+		// Leave the rest for the SFRX in vCC2500_EnterRX()
+		return 0;
+	}
+
+	ucCC2500_BurstReadRegisters(RX_FIFO, &pucPacket[PKT_LENGTH + 1],
+	                            pucPacket[PKT_LENGTH] + PKT_STATUS_LENGTH);
+
+#ifdef BENCHMARK
+	vBench_AddAirtime(pucPacket[PKT_LENGTH], 0);
+#endif
+	return pucPacket[PKT_LENGTH];
+}
+
+
+#ifdef BASE
+
+//******************************************************************************
+// ulTicks()
+//
+// The 32-bit tick count. Called with interrupts off, so an overflow that is
+// still pending is added in here. TAR runs off the VLO, not MCLK, so it is
+// read until two reads agree.
+//******************************************************************************
+
+static unsigned long ulTicks()
+{
+	unsigned int uiHigh = g_uiTickOverflows;
+	unsigned int uiLow;
+
+	do
+	{
+		uiLow = TAR;
+	} while ( uiLow != TAR );
+
+	if ( (TACTL & TAIFG) && uiLow < 0x8000 )
+	{
+		++uiHigh;
+	}
+	return ((unsigned long)uiHigh << 16) | uiLow;
+}
+
+
+//******************************************************************************
+// vPutLink( pucRecord, ulTimestamp )
+//
+// Writes the REC_LINK_LENGTH bytes of link information into a record: the
+// time the packet ended, then the RSSI and LQI appended to the packet in
+// g_ucaRXPacket.
+//******************************************************************************
+
+static void vPutLink(unsigned char * pucRecord, unsigned long ulTimestamp)
+{
+	unsigned char ucLength = g_ucaRXPacket[PKT_LENGTH];
+
+	pucRecord[0] = ulTimestamp >> 24;
+	pucRecord[1] = ulTimestamp >> 16;
+	pucRecord[2] = ulTimestamp >> 8;
+	pucRecord[3] = ulTimestamp & 255;
+	pucRecord[4] = g_ucaRXPacket[ucLength + 1];
+	pucRecord[5] = g_ucaRXPacket[ucLength + 2] & 0x7F;
+}
+
+
+//******************************************************************************
+// vSendRecord( ucType, pucPayload, ucLength )
+//
+// Frames LENGTH bytes of PAYLOAD as a record of TYPE and sends it to the PC
+//******************************************************************************
+
+static void vSendRecord(unsigned char ucType, unsigned char * pucPayload,
+                        unsigned char ucLength)
+{
+	unsigned char ucaHeader[3];
+	unsigned char ucChecksum = ucType + ucLength;
+	unsigned char ucIndex;
+
+	for ( ucIndex = 0; ucIndex < ucLength; ++ucIndex )
+	{
+		ucChecksum += pucPayload[ucIndex];
+	}
+
+	ucaHeader[0] = REC_SYNC;
+	ucaHeader[1] = ucType;
+	ucaHeader[2] = ucLength;
+	vUSCI_A0_UART_SendBytes(ucaHeader, 3);
+	vUSCI_A0_UART_SendBytes(pucPayload, ucLength);
+	vUSCI_A0_UART_SendBytes(&ucChecksum, 1);
+}
+
+
+//******************************************************************************
+// vScanChannels( ucBoot )
+//
+// Sweeps the candidate channels for the quietest one. At boot the BASE just
+// moves there, the REMOTEs will find it. Later on the move is only announced
+// in the ACKs and made after CHANNEL_ANNOUNCE of them, and only when the new
+// channel is clearly better. The packet interrupt is off during the sweep,
+// anything heard on a scanned channel is dropped.
+//******************************************************************************
+
+static void vScanChannels(unsigned char ucBoot)
+{
+	unsigned char ucChannel = g_ucCC2500_Channel;
+	unsigned char ucBest;
+	unsigned char ucIndex;
+	signed char cCurrent = 127;
+
+	P2IE &= ~BIT6;
+	ucBest = ucCC2500_FindClearChannel(g_ucaChannels, CHANNEL_COUNT,
+	                                   g_caChannelRSSI);
+	__disable_interrupt();
+	g_ucWakeEvents &= ~WAKE_RADIO;
+	__enable_interrupt();
+	P2IFG &= ~BIT6;
+	P2IE |= BIT6;
+
+	if ( ucBoot )
+	{
+		g_ucNextChannel = g_ucaChannels[ucBest];
+		vCC2500_SetChannel(g_ucNextChannel);
+		return;
+	}
+
+	for ( ucIndex = 0; ucIndex < CHANNEL_COUNT; ++ucIndex )
+	{
+		if ( g_ucaChannels[ucIndex] == ucChannel )
+		{
+			cCurrent = g_caChannelRSSI[ucIndex];
+		}
+	}
+
+	if ( g_ucAnnounce == 0 && !g_ucChannelPinned &&
+	     g_caChannelRSSI[ucBest] + CHANNEL_HYSTERESIS < cCurrent )
+	{
+		g_ucNextChannel = g_ucaChannels[ucBest];
+		g_ucAnnounce = CHANNEL_ANNOUNCE;
+	}
+
+	// Back to the channel the REMOTEs are on
+	vCC2500_SetChannel(ucChannel);
+}
+
+
+//******************************************************************************
+// ucQueueConfig( pucCommand )
+//
+// Stores a CMD_SET_NODE_CONFIG payload in a configuration slot. A broadcast
+// replaces every slot, since it retunes the whole fleet. A node without a
+// slot gets an empty one, or failing that one that is done as long as no
+// broadcast is queued. Returns a REPLY_xxx status.
+//******************************************************************************
+
+static unsigned char ucQueueConfig(unsigned char * pucCommand)
+{
+	unsigned char ucNode = pucCommand[0];
+	unsigned int uiPeriod = (pucCommand[2] << 8) | pucCommand[3];
+	unsigned char ucSlot;
+	unsigned char ucFree = CONFIG_SLOTS;
+	unsigned char ucDone = CONFIG_SLOTS;
+	unsigned char ucBroadcast = 0;
+	unsigned char ucByte;
+
+	if ( ucNode == PKT_BASE_ADDRESS || pucCommand[1] == 0 ||
+	     uiPeriod < CONFIG_MIN_PERIOD || uiPeriod > CONFIG_MAX_PERIOD ||
+	     pucCommand[5] > 3 )
+	{
+		return REPLY_BAD_COMMAND;
+	}
+
+	if ( ucNode == PKT_BROADCAST )
+	{
+		g_ucConfigDone = 0;
+	}
+
+	for ( ucSlot = 0; ucSlot < CONFIG_SLOTS; ++ucSlot )
+	{
+		if ( ucNode == PKT_BROADCAST )
+		{
+			g_ucaConfigNode[ucSlot] = 0;
+		}
+		if ( g_ucaConfigNode[ucSlot] == PKT_BROADCAST )
+		{
+			ucBroadcast = 1;
+		}
+		if ( g_ucaConfigNode[ucSlot] == ucNode )
+		{
+			ucFree = ucSlot;
+		}
+		else if ( g_ucaConfigNode[ucSlot] == 0 && ucFree == CONFIG_SLOTS )
+		{
+			ucFree = ucSlot;
+		}
+		else if ( (g_ucConfigDone & (1 << ucSlot)) && ucDone == CONFIG_SLOTS )
+		{
+			ucDone = ucSlot;
+		}
+	}
+
+	// Only take a finished slot from another node if nothing else is left,
+	// and not while a broadcast would be what that node gets instead
+	if ( ucFree == CONFIG_SLOTS && !ucBroadcast )
+	{
+		ucFree = ucDone;
+	}
+	if ( ucFree == CONFIG_SLOTS )
+	{
+		return REPLY_QUEUE_FULL;
+	}
+
+	g_ucaConfigNode[ucFree] = ucNode;
+	g_ucConfigDone &= ~(1 << ucFree);
+	for ( ucByte = 0; ucByte < CONFIG_BYTES; ++ucByte )
+	{
+		g_ucaConfig[ucFree][ucByte] = pucCommand[ucByte + 1];
+	}
+	return REPLY_OK;
+}
+
+
+//******************************************************************************
+// ucFindConfig( ucNode )
+//
+// Returns the configuration slot that applies to NODE, its own if it has one,
+// otherwise the broadcast one. Returns CONFIG_SLOTS if there is none.
+//******************************************************************************
+
+static unsigned char ucFindConfig(unsigned char ucNode)
+{
+	unsigned char ucSlot;
+	unsigned char ucFound = CONFIG_SLOTS;
+
+	for ( ucSlot = 0; ucSlot < CONFIG_SLOTS; ++ucSlot )
+	{
+		if ( g_ucaConfigNode[ucSlot] == ucNode )
+		{
+			return ucSlot;
+		}
+		if ( g_ucaConfigNode[ucSlot] == PKT_BROADCAST )
+		{
+			ucFound = ucSlot;
+		}
+	}
+	return ucFound;
+}
+
+
+//******************************************************************************
+// vSendDiagnostics()
+//
+// Sends the REC_DIAG record, see record.h
+//******************************************************************************
+
+static void vSendDiagnostics()
+{
+	unsigned int uiaDiag[REC_DIAG_LENGTH / 2];
+	unsigned char ucaDiag[REC_DIAG_LENGTH];
+	unsigned char ucIndex;
+
+	uiaDiag[0] = uiStack_HighWater();
+	uiaDiag[1] = uiStack_Size();
+	uiaDiag[2] = g_uiUSCI_A0_RXOverruns;
+	uiaDiag[3] = g_uiCRCErrors;
+	uiaDiag[4] = g_uiCC2500_SPISaved;
+
+	for ( ucIndex = 0; ucIndex < REC_DIAG_LENGTH / 2; ++ucIndex )
+	{
+		ucaDiag[2 * ucIndex] = uiaDiag[ucIndex] >> 8;
+		ucaDiag[2 * ucIndex + 1] = uiaDiag[ucIndex] & 255;
+	}
+	vSendRecord(REC_DIAG, ucaDiag, REC_DIAG_LENGTH);
+}
+
+
+//******************************************************************************
+// ucIsCandidate( ucChannel )
+//
+// Returns 1 if CHANNEL is one of g_ucaChannels, the only ones a REMOTE that
+// lost the BASE searches
+//******************************************************************************
+
+static unsigned char ucIsCandidate(unsigned char ucChannel)
+{
+	unsigned char ucIndex;
+
+	for ( ucIndex = 0; ucIndex < CHANNEL_COUNT; ++ucIndex )
+	{
+		if ( g_ucaChannels[ucIndex] == ucChannel )
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+//******************************************************************************
+// vRunCommand()
+//
+// Carries out the complete command in g_ucaCommand and replies to the PC.
+// Nothing here waits on the radio, so commands never hold up a packet.
+//******************************************************************************
+
+static void vRunCommand()
+{
+	unsigned char ucLength = g_ucaCommand[1];
+	unsigned char ucChecksum = 0;
+	unsigned char ucIndex;
+	unsigned char ucaReply[REC_REPLY_LENGTH];
+
+	for ( ucIndex = 0; ucIndex < ucLength + 2; ++ucIndex )
+	{
+		ucChecksum += g_ucaCommand[ucIndex];
+	}
+
+	ucaReply[0] = g_ucaCommand[0];
+	ucaReply[1] = REPLY_OK;
+
+	if ( ucChecksum != g_ucaCommand[ucLength + 2] )
+	{
+		ucaReply[1] = REPLY_BAD_CHECKSUM;
+	}
+	else if ( g_ucaCommand[0] == CMD_SET_TX_POWER && ucLength == 1 )
+	{
+		vCC2500_SetTXPower(g_ucaCommand[2]);
+	}
+	else if ( g_ucaCommand[0] == CMD_SET_CHANNEL && ucLength == 1 &&
+	          ucIsCandidate(g_ucaCommand[2]) )
+	{
+		// Moved the same way as after a scan, so the REMOTEs come along
+		g_ucChannelPinned = 1;
+		g_ucNextChannel = g_ucaCommand[2];
+		g_ucAnnounce = CHANNEL_ANNOUNCE;
+	}
+	else if ( g_ucaCommand[0] == CMD_SET_CHANNEL && ucLength == 0 )
+	{
+		g_ucChannelPinned = 0;
+	}
+	else if ( g_ucaCommand[0] == CMD_SET_NODE_CONFIG &&
+	          ucLength == CMD_NODE_CONFIG_LENGTH )
+	{
+		ucaReply[1] = ucQueueConfig(&g_ucaCommand[2]);
+	}
+	else if ( g_ucaCommand[0] == CMD_GET_DIAG && ucLength == 0 )
+	{
+		vSendDiagnostics();
+	}
+	else
+	{
+		ucaReply[1] = REPLY_BAD_COMMAND;
+	}
+
+	vSendRecord(REC_REPLY, ucaReply, REC_REPLY_LENGTH);
+}
+
+
+//******************************************************************************
+// vProcessCommands()
+//
+// Feeds whatever the UART has received through the command framing and runs
+// each command once all of it is in. Partial commands stay in g_ucaCommand
+// until the rest arrives.
+//******************************************************************************
+
+static void vProcessCommands()
+{
+	unsigned char ucByte;
+
+	while ( ucUSCI_A0_UART_ReadByte(&ucByte) )
+	{
+		if ( g_ucCommandIndex == 0 )
+		{
+			// Hunting for the start of a command
+			if ( ucByte == REC_SYNC )
+			{
+				g_ucCommandIndex = 1;
+			}
+			continue;
+		}
+
+		g_ucaCommand[g_ucCommandIndex - 1] = ucByte;
+		++g_ucCommandIndex;
+
+		// Length byte just came in, give up on anything too long
+		if ( g_ucCommandIndex == 3 && g_ucaCommand[1] > CMD_MAX_LENGTH )
+		{
+			g_ucCommandIndex = 0;
+		}
+		else if ( g_ucCommandIndex > 3 &&
+		          g_ucCommandIndex == g_ucaCommand[1] + 4 )
+		{
+			vRunCommand();
+			g_ucCommandIndex = 0;
+		}
+	}
+}
+
+
+
+//******************************************************************************
+// vStoreFragment( ulTimestamp )
+//
+// Copies the PKT_CAPTURE fragment in g_ucaRXPacket into the waveform record
+// and sends the record once every fragment is in, with the link information
+// of the last one (TIMESTAMP is when it ended). A fragment of a different
+// capture starts the record over.
+//******************************************************************************
+
+static void vStoreFragment(unsigned long ulTimestamp)
+{
+	unsigned char ucFragment = g_ucaRXPacket[PKT_CAPTURE_FRAGMENT];
+	unsigned char * pucData;
+	unsigned char ucIndex;
+
+	if ( ucFragment >= PKT_CAPTURE_FRAGMENTS )
+	{
+		return;
+	}
+
+	if ( g_ucaWaveform[0] != g_ucaRXPacket[PKT_ADDRESS] ||
+	     g_ucaWaveform[1] != g_ucaRXPacket[PKT_CAPTURE_ID] )
+	{
+		g_ucaWaveform[0] = g_ucaRXPacket[PKT_ADDRESS];
+		g_ucaWaveform[1] = g_ucaRXPacket[PKT_CAPTURE_ID];
+		g_ucaWaveform[2] = g_ucaRXPacket[PKT_CAPTURE_TRIGGER];
+		g_ucCaptureFragments = 0;
+	}
+
+	pucData = &g_ucaWaveform[3 + REC_LINK_LENGTH +
+	                         ucFragment * 2 * PKT_FRAGMENT_SAMPLES];
+	for ( ucIndex = 0; ucIndex < 2 * PKT_FRAGMENT_SAMPLES; ++ucIndex )
+	{
+		pucData[ucIndex] = g_ucaRXPacket[PKT_CAPTURE_DATA + ucIndex];
+	}
+
+	g_ucCaptureFragments |= 1 << ucFragment;
+	if ( g_ucCaptureFragments == (1 << PKT_CAPTURE_FRAGMENTS) - 1 )
+	{
+		vPutLink(&g_ucaWaveform[3], ulTimestamp);
+		vSendRecord(REC_WAVEFORM, g_ucaWaveform, REC_WAVEFORM_LENGTH);
+
+		// Fragments resent because an ACK was lost don't make a second one
+		g_ucCaptureFragments = 0;
+	}
+}
+
+#endif
+
+
+#ifdef REMOTE
+
+//******************************************************************************
+// vRadioWake() / vRadioSleep()
+//
+// Brings the radio back from SLEEP and puts it back. GDO0 floats while the
+// radio sleeps, so its interrupt stays off until the registers are back.
+//******************************************************************************
+
+static void vRadioWake()
+{
+	vCC2500_Wake();
+	P2IFG &= ~BIT6;
+	P2IE |= BIT6;
+}
+
+static void vRadioSleep()
+{
+	P2IE &= ~BIT6;
+	vCC2500_Sleep();
+}
+
+
+//******************************************************************************
+// vSetTimeout( uiTicks ) / vStartAckTimeout() / vStopAckTimeout()
+//
+// Uses TACCR1 to set WAKE_TIMEOUT if no ACK shows up. TACCR0 sets the
+// period in up mode, where the counter runs from 0 to TACCR0, so the compare
+// value wraps modulo TACCR0 + 1. TAR + uiTicks can overflow with the longest
+// periods, so the ticks left in the period are taken off first.
+//******************************************************************************
+
+static void vSetTimeout(unsigned int uiTicks)
+{
+	unsigned int uiLeft = TACCR0 - TAR;
+
+	if ( uiTicks > uiLeft )
+	{
+		TACCR1 = uiTicks - uiLeft - 1;
+	}
+	else
+	{
+		TACCR1 = TAR + uiTicks;
+	}
+}
+
+static void vStartAckTimeout()
+{
+	vSetTimeout(ACK_TIMEOUT);
+	g_ucTimeoutMoved = 0;
+	TACCTL1 = CCIE;
+}
+
+static void vStopAckTimeout()
+{
+	TACCTL1 = 0;
+}
+
+
+//******************************************************************************
+// uiRandom()
+//
+// 16-bit Galois LFSR, plenty for spreading out transmit times
+//******************************************************************************
+
+static unsigned int uiRandom()
+{
+	// An all-zero state would stick
+	if ( g_uiRandom == 0 )
+	{
+		g_uiRandom = NODE_ID;
+	}
+	g_uiRandom = (g_uiRandom >> 1) ^ (-(g_uiRandom & 1u) & 0xB400u);
+	return g_uiRandom;
+}
+
+
+//******************************************************************************
+// ucWaitForAck()
+//
+// Listens until an ACK for this node arrives or the timeout runs out. ACKs
+// meant for other REMOTEs and bad packets are skipped. Returns 1 if the ACK
+// arrived, it is then in g_ucaRXPacket.
+//******************************************************************************
+
+static unsigned char ucWaitForAck()
+{
+	unsigned char ucEvents;
+	unsigned char ucLength;
+
+	vStartAckTimeout();
+	while (1)
+	{
+		ucEvents = ucSleepUntil(WAKE_RADIO | WAKE_TIMEOUT);
+
+		if ( (ucEvents & WAKE_RADIO) && g_ucRXPacketOK )
+		{
+			ucLength = ucReceivePacket(g_ucaRXPacket);
+			if ( (ucLength == PKT_ACK_LENGTH ||
+			      ucLength == PKT_ACK_CONFIG_LENGTH) &&
+			     g_ucaRXPacket[PKT_TYPE] == PKT_ACK &&
+			     g_ucaRXPacket[PKT_ADDRESS] == NODE_ID )
+			{
+				vStopAckTimeout();
+				return 1;
+			}
+		}
+
+		if ( ucEvents & WAKE_TIMEOUT )
+		{
+			return 0;
+		}
+
+		// Someone else's packet, keep listening
+		vCC2500_EnterRX();
+	}
+}
+
+#endif
+
+
+#ifdef REMOTE
+
+//******************************************************************************
+// vHopTo( ucChannel )
+//
+// Moves to CHANNEL and carries on any search from there
+//******************************************************************************
+
+static void vHopTo(unsigned char ucChannel)
+{
+	unsigned char ucIndex;
+
+	for ( ucIndex = 0; ucIndex < CHANNEL_COUNT; ++ucIndex )
+	{
+		if ( g_ucaChannels[ucIndex] == ucChannel )
+		{
+			g_ucHopIndex = ucIndex;
+		}
+	}
+	vCC2500_SetChannel(ucChannel);
+}
+
+
+//******************************************************************************
+// vFollowBase()
+//
+// Acts on the channel in the ACK in g_ucaRXPacket. The move is made with the
+// ACK that says the BASE is moving now; before that the channel is only
+// remembered, in case that ACK is missed.
+//******************************************************************************
+
+static void vFollowBase()
+{
+	unsigned char ucChannel = g_ucaRXPacket[PKT_ACK_CHANNEL];
+
+	if ( ucChannel == g_ucCC2500_Channel )
+	{
+		g_ucPendingChannel = 0;
+	}
+	else if ( g_ucaRXPacket[PKT_ACK_SWITCH] == 0 )
+	{
+		g_ucPendingChannel = 0;
+		vHopTo(ucChannel);
+	}
+	else
+	{
+		g_ucPendingChannel = ucChannel;
+	}
+}
+
+
+//******************************************************************************
+// vApplyConfig()
+//
+// Takes on the configuration in the ACK in g_ucaRXPacket, if there is one
+// and it is not the version already running. Called between samples, so the
+// ADC10 is off (ENC clear) and the radio is in IDLE.
+//******************************************************************************
+
+static void vApplyConfig()
+{
+	unsigned int uiPeriod;
+
+	if ( g_ucaRXPacket[PKT_LENGTH] != PKT_ACK_CONFIG_LENGTH ||
+	     g_ucaRXPacket[PKT_ACK_VERSION] == g_ucConfigVersion )
+	{
+		return;
+	}
+
+	uiPeriod = (g_ucaRXPacket[PKT_ACK_PERIOD] << 8) |
+	           g_ucaRXPacket[PKT_ACK_PERIOD + 1];
+	if ( uiPeriod < CONFIG_MIN_PERIOD )
+	{
+		uiPeriod = CONFIG_MIN_PERIOD;
+	}
+	if ( uiPeriod > CONFIG_MAX_PERIOD )
+	{
+		uiPeriod = CONFIG_MAX_PERIOD;
+	}
+	g_uiSamplePeriod = uiPeriod;
+
+	vCC2500_SetTXPower(g_ucaRXPacket[PKT_ACK_TX_POWER]);
+
+	ADC10CTL0 = (ADC10CTL0 & ~ADC10SHT_3) |
+	            ((g_ucaRXPacket[PKT_ACK_ADC_SHT] & 0x03) << 11);
+
+#ifdef CAPTURE
+	g_uiCaptureLevel = g_ucaRXPacket[PKT_ACK_LEVEL] << 2;
+	g_uiCaptureSlope = g_ucaRXPacket[PKT_ACK_SLOPE];
+#endif
+
+	g_ucConfigVersion = g_ucaRXPacket[PKT_ACK_VERSION];
+}
+
+
+
+//******************************************************************************
+// uiPanelPower( uiVoltage, uiCurrent )
+//
+// Panel power in mW from the voltage and current in ADC10 counts, in fixed
+// point. Each reading is scaled on its own first so nothing overflows 32 bits.
+//******************************************************************************
+
+static unsigned int uiPanelPower(unsigned int uiVoltage, unsigned int uiCurrent)
+{
+	unsigned long ulMillivolts;
+	unsigned long ulMilliamps;
+
+	ulMillivolts = ((unsigned long)uiVoltage * VOLTAGE_FULL_SCALE_MV) / 1023;
+	ulMilliamps = ((unsigned long)uiCurrent * CURRENT_FULL_SCALE_MA) / 1023;
+
+	// Rounded to the nearest mW
+	return (unsigned int)((ulMillivolts * ulMilliamps + 500) / 1000);
+}
+
+#endif
+
+
+#ifdef CAPTURE
+
+//******************************************************************************
+// vCaptureStart() / vCaptureStop()
+//
+// Runs the ADC10 on the panel voltage over and over, with the DTC storing the
+// samples in the ring a block at a time. The ADC10 ISR moves the DTC on to
+// the next block. Stopping puts the ADC10 back to the channel sequence the
+// sample in the main loop expects.
+//******************************************************************************
+
+static void vCaptureStart()
+{
+	g_uiCaptureFilled = 0;
+	g_uiCaptureStopAt = 0;
+	g_ucCapturing = 1;
+
+	ADC10CTL1 &= ~(INCH_15 + CONSEQ_3);
+	ADC10CTL1 |= INCH_0 + CONSEQ_2;
+	ADC10CTL0 |= REFON + ADC10ON;
+	ADC10DTC0 = 0;
+	ADC10DTC1 = CAPTURE_BLOCK;
+	ADC10SA = (unsigned int)g_uiaCapture;
+	ADC10CTL0 |= ENC + ADC10SC;
+}
+
+static void vCaptureStop()
+{
+	// Clearing ENC stops the sequence at the end of the conversion
+	ADC10CTL0 &= ~ENC;
+	while ( ADC10CTL1 & ADC10BUSY );
+
+	ADC10DTC1 = 0;
+	ADC10CTL1 &= ~(INCH_15 + CONSEQ_3);
+	ADC10CTL1 |= INCH_10 + CONSEQ_1;
+	ADC10CTL0 &= ~(REFON + ADC10ON);
+
+	__disable_interrupt();
+	g_ucCapturing = 0;
+	g_ucWakeEvents &= ~WAKE_ADC;
+	__enable_interrupt();
+}
+
+
+//******************************************************************************
+// ucCaptureTrigger( uiBlock )
+//
+// Looks for a trigger in BLOCK (counted from the start of the capture, and
+// not 0 since the sample before the block is needed). Returns the index in
+// the block of the sample that fired, or CAPTURE_BLOCK if none did.
+//******************************************************************************
+
+static unsigned char ucCaptureTrigger(unsigned int uiBlock)
+{
+	unsigned int * puiSample;
+	unsigned int uiPrevious;
+	unsigned char ucIndex;
+
+	puiSample = &g_uiaCapture[(uiBlock % CAPTURE_BLOCKS) * CAPTURE_BLOCK];
+	uiPrevious = g_uiaCapture[(uiBlock * CAPTURE_BLOCK - 1) % PKT_CAPTURE_SAMPLES];
+
+	for ( ucIndex = 0; ucIndex < CAPTURE_BLOCK; ++ucIndex )
+	{
+		if ( g_uiCaptureLevel &&
+		     (uiPrevious < g_uiCaptureLevel) !=
+		     (puiSample[ucIndex] < g_uiCaptureLevel) )
+		{
+			return ucIndex;
+		}
+		if ( g_uiCaptureSlope &&
+		     abs((int)puiSample[ucIndex] - (int)uiPrevious) >= g_uiCaptureSlope )
+		{
+			return ucIndex;
+		}
+		uiPrevious = puiSample[ucIndex];
+	}
+	return CAPTURE_BLOCK;
+}
+
+
+//******************************************************************************
+// vSendCapture( uiFirst, ucTrigger )
+//
+// Sends the ring, oldest block (FIRST) first, to the BASE as numbered
+// PKT_CAPTURE fragments. TRIGGER is the index of the sample that fired. Each
+// fragment has to be ACKed, if one isn't after CAPTURE_TRIES the rest are
+// dropped.
+//******************************************************************************
+
+static void vSendCapture(unsigned int uiFirst, unsigned char ucTrigger)
+{
+	unsigned char ucStart = (uiFirst % CAPTURE_BLOCKS) * CAPTURE_BLOCK;
+	unsigned char ucFragment;
+	unsigned char ucIndex;
+	unsigned char ucTry;
+	unsigned char * pucData;
+	unsigned int uiSample;
+
+	vRadioWake();
+
+	g_ucaTXPacket[PKT_LENGTH] = PKT_CAPTURE_LENGTH;
+	g_ucaTXPacket[PKT_ADDRESS] = NODE_ID;
+	g_ucaTXPacket[PKT_TYPE] = PKT_CAPTURE;
+	g_ucaTXPacket[PKT_CAPTURE_ID] = g_ucCaptureId++;
+	g_ucaTXPacket[PKT_CAPTURE_TRIGGER] = ucTrigger;
+
+	for ( ucFragment = 0; ucFragment < PKT_CAPTURE_FRAGMENTS; ++ucFragment )
+	{
+		g_ucaTXPacket[PKT_CAPTURE_FRAGMENT] = ucFragment;
+
+		pucData = &g_ucaTXPacket[PKT_CAPTURE_DATA];
+		for ( ucIndex = 0; ucIndex < PKT_FRAGMENT_SAMPLES; ++ucIndex )
+		{
+			uiSample = g_uiaCapture[(ucStart + ucIndex +
+			                         ucFragment * PKT_FRAGMENT_SAMPLES) %
+			                        PKT_CAPTURE_SAMPLES];
+			*pucData++ = uiSample >> 8;
+			*pucData++ = uiSample & 255;
+		}
+
+		for ( ucTry = 0; ucTry < CAPTURE_TRIES; ++ucTry )
+		{
+			vSendPacket(g_ucaTXPacket);
+			ucSleepUntil(WAKE_RADIO);
+			if ( ucWaitForAck() )
+			{
+				vFollowBase();
+				break;
+			}
+		}
+
+		if ( ucTry == CAPTURE_TRIES )
+		{
+			break;
+		}
+	}
+
+	vRadioSleep();
+}
+
+
+//******************************************************************************
+// vCaptureUntilTimer()
+//
+// Watches the solar panel at full ADC10 speed until the next sample period
+// starts. Each block is checked for a trigger as it comes in. When one fires
+// the ring is frozen once the blocks after it are in, then sent to the BASE.
+// At most one capture is sent per sample period.
+//******************************************************************************
+
+static void vCaptureUntilTimer()
+{
+	unsigned char ucEvents;
+	unsigned char ucTrigger = 0;
+	unsigned int uiChecked = 1;
+	unsigned int uiBlock;
+
+	vCaptureStart();
+	while ( 1 )
+	{
+		ucEvents = ucSleepUntil(WAKE_TIMER | WAKE_ADC);
+
+		if ( g_uiCaptureStopAt && g_uiCaptureFilled == g_uiCaptureStopAt )
+		{
+			vCaptureStop();
+			vSendCapture(g_uiCaptureStopAt - CAPTURE_BLOCKS,
+			             CAPTURE_BLOCK + ucTrigger);
+			if ( !(ucEvents & WAKE_TIMER) )
+			{
+				ucSleepUntil(WAKE_TIMER);
+			}
+			return;
+		}
+
+		if ( ucEvents & WAKE_TIMER )
+		{
+			break;
+		}
+
+		// Block 0 has no block before it, so checking starts at 1
+		while ( !g_uiCaptureStopAt && uiChecked < g_uiCaptureFilled )
+		{
+			uiBlock = uiChecked++;
+			ucTrigger = ucCaptureTrigger(uiBlock);
+			if ( ucTrigger == CAPTURE_BLOCK )
+			{
+				continue;
+			}
+
+			// Stop once the ring holds the block before this one and the
+			// blocks after it, unless the ring has already gone past that
+			__disable_interrupt();
+			if ( g_uiCaptureFilled < uiBlock + CAPTURE_BLOCKS - 1 )
+			{
+				g_uiCaptureStopAt = uiBlock + CAPTURE_BLOCKS - 1;
+			}
+			__enable_interrupt();
+		}
+	}
+	vCaptureStop();
+}
+
+#endif
 
 
 //******************************************************************************
@@ -53,9 +1260,26 @@ unsigned char g_ucRXFlag = 0;
 
 void main(void)
 {
+#ifdef BASE
+    unsigned char ucEvents;
+    unsigned char ucSlot;
+    unsigned char ucIndex;
+    unsigned char ucLength;
+    unsigned long ulTimestamp;
+#endif
+#ifdef REMOTE
+    unsigned int uiCurrent;
+    unsigned int uiTemperature;
+    unsigned int uiPower;
+#endif
+
     // Stop watch dog timer
     WDTCTL = WDTPW + WDTHOLD;
 
+    // Fill the unused stack so uiStack_HighWater() can find how much of it
+    // has been used
+    vStack_Paint();
+
     // DCO = 16 MHz and calibrated with BCSCTL1 register
     DCOCTL = CALDCO_16MHZ;
     BCSCTL1 = CALBC1_16MHZ;
@@ -72,6 +1296,12 @@ void main(void)
 	// Initialize CC2500
     vCC2500_Init();
 
+#ifdef BENCHMARK
+    // Driver benchmarks run first, the profile load below sets everything back
+    vBench_Init();
+    vBench_RunDrivers();
+#endif
+
 	// Write CC2500 registers with correct configurations for transmission
     vCC2500_LoadProfile(0);
 
@@ -79,34 +1309,33 @@ void main(void)
     vCC2500_SetTXPower(POS_01_DBM);
 
 	// Idle the CC2500 to begin accepting SRX/STX strobes
-    ucCC2500_SendCommandStrobe(SIDLE);
+    vCC2500_EnterIdle();
 
-    // Select pins for digital I/O
-	P2SEL &= ~(BIT6);
+    // Select pins for digital I/O (P2.6 = GDO0, P2.7 = GDO2)
+	P2SEL &= ~(BIT6 | BIT7);
 
-	// P2.6 as an input
-	P2DIR &= ~BIT6;
+	// P2.6 and P2.7 as inputs
+	P2DIR &= ~(BIT6 | BIT7);
 
 	// Selects interrupt edge with P2.6
 	P2IES |= BIT6;
 
-	// Enable interrupt for P2.6
-	P2IE |= BIT6;
-
 	// Sets bit when selected transition has been detected on the input
 	P2IFG &= ~BIT6;
 
+	// Enable interrupt for P2.6, left on for good since the ISR reports
+	// through g_ucWakeEvents
+	P2IE |= BIT6;
+
     // Enable general interrupts
     __bis_SR_register(GIE);
 
-    // Clear the receiver FIFO with strobe command
-	ucCC2500_SendCommandStrobe(SFRX);
-
-	// Clear the transmit FIFO with strobe command
-	ucCC2500_SendCommandStrobe(SFTX);
+    // No FIFO flushes needed here, the SRES in vCC2500_LoadProfile already
+    // emptied both FIFOs and the state tracker knows it
 
     // Sets the channel for transmission to 131 (13th independent channel in classroom hopefully)
-    ucCC2500_WriteSingleRegister(CHANNR, 0x83);
+    // Autocalibration is off, so this also runs the one calibration for it
+    vCC2500_SetChannel(DEFAULT_CHANNEL);
 
 
     // If BASE is defined, the following code is executed
@@ -115,38 +1344,102 @@ void main(void)
     	// Initialize UART communication on for BASE once; Not needed for REMOTE
         vUSCI_A0_UART_Init();
 
+        // Timestamps come from Timer_A counting the VLO continuously, with
+        // an interrupt on each overflow
+        BCSCTL3 |= LFXT1S_2;
+        TACTL = TASSEL_1 + MC_2 + TACLR + TAIE;
+
+        // Start on the quietest channel, the REMOTEs search until they find it
+        vScanChannels(1);
+
         // Loop continues forever
         while(1)
 		{
-				// Clear the receiver buffer with strobe command
-				ucCC2500_SendCommandStrobe(SFRX);
+#ifdef BENCHMARK
+				vBench_Start(BENCH_BASE_LOOP);
+#endif
 
-				// Enable interrupt for P2.6
-				P2IE |= BIT6;
+				// Recalibrate the synthesizer every so often
+				vCC2500_CalibrationTick();
 
-				// Sets bit when selected transition has been detected on the input
-				P2IFG &= ~BIT6;
+				// Look for a clearer channel every so often
+				if ( --g_uiScanCountdown == 0 )
+				{
+					g_uiScanCountdown = SCAN_INTERVAL;
+					vScanChannels(0);
+				}
 
 				// Set receive flag for BASE to receive input from REMOTE
 				g_ucRXFlag = 1;
 
-				// Enable CC2500 packet TX interrupt
-				P2IE |= BIT6;
+				// Put the CC2500 in RX; nothing is strobed if it went there
+				// by itself after the last ACK
+				vCC2500_EnterRX();
 
-				// Command the CC250 to transmit the string  STX strobe
-				ucCC2500_SendCommandStrobe(SRX);
-
-				// Wait for finish (sleep)
-				__bis_SR_register( LPM3_bits + GIE );
+				// Wait for finish (sleep), handling commands from the PC
+				// while nothing is coming in over the air
+				while ( 1 )
+				{
+					ucEvents = ucSleepUntil(WAKE_RADIO | WAKE_UART);
+					if ( ucEvents & WAKE_UART )
+					{
+						vProcessCommands();
+					}
+					if ( ucEvents & WAKE_RADIO )
+					{
+						break;
+					}
+				}
 
-				// Enable packet RXinterrupt
-				P2IE  |=  BIT6;
+				// CRC failed and the packet was flushed, go back to RX
+				if ( !g_ucRXPacketOK )
+				{
+					++g_uiCRCErrors;
+					continue;
+				}
 
-				// Received the packet
-				P2IE  &=  ~BIT6;
+				// Read the packet from the receive buffer (RX_FIFO), samples
+				// and capture fragments are ACKed the same way
+				ulTimestamp = g_ulRXTimestamp;
+				ucLength = ucReceivePacket(g_ucaRXPacket);
+				if ( !(ucLength == PKT_SAMPLE_LENGTH &&
+				       g_ucaRXPacket[PKT_TYPE] == PKT_SAMPLE) &&
+				     !(ucLength == PKT_CAPTURE_LENGTH &&
+				       g_ucaRXPacket[PKT_TYPE] == PKT_CAPTURE) )
+				{
+					continue;
+				}
 
-				// Read the 2 bytes from the receive buffer (RX_FIFO)
-				ucCC2500_BurstReadRegisters(RX_FIFO, g_ucaRXInput, 2);
+				// ACK right away, the REMOTE is only listening for a moment.
+				// The ACK tells it which channel to be on, and while a move
+				// is announced, how many ACKs are left before it happens.
+				g_ucaTXPacket[PKT_LENGTH] = PKT_ACK_LENGTH;
+				g_ucaTXPacket[PKT_ADDRESS] = g_ucaRXPacket[PKT_ADDRESS];
+				g_ucaTXPacket[PKT_TYPE] = PKT_ACK;
+				g_ucaTXPacket[PKT_ACK_CHANNEL] = g_ucNextChannel;
+				g_ucaTXPacket[PKT_ACK_SWITCH] = g_ucAnnounce ? g_ucAnnounce - 1 : 0;
+
+				// Tack on a new configuration if the REMOTE isn't running it,
+				// or mark its own slot done if it is
+				ucSlot = ucFindConfig(g_ucaRXPacket[PKT_ADDRESS]);
+				if ( g_ucaRXPacket[PKT_TYPE] == PKT_SAMPLE &&
+				     ucSlot < CONFIG_SLOTS )
+				{
+					if ( g_ucaConfig[ucSlot][0] != g_ucaRXPacket[PKT_SAMPLE_VERSION] )
+					{
+						for ( ucIndex = 0; ucIndex < CONFIG_BYTES; ++ucIndex )
+						{
+							g_ucaTXPacket[PKT_ACK_VERSION + ucIndex] =
+								g_ucaConfig[ucSlot][ucIndex];
+						}
+						g_ucaTXPacket[PKT_LENGTH] = PKT_ACK_CONFIG_LENGTH;
+					}
+					else if ( g_ucaConfigNode[ucSlot] == g_ucaRXPacket[PKT_ADDRESS] )
+					{
+						g_ucConfigDone |= 1 << ucSlot;
+					}
+				}
+				vSendPacket(g_ucaTXPacket);
 
 				// Light red LED
 				LED_FLASH(RED_LED);
@@ -154,14 +1447,41 @@ void main(void)
 				// Light green LED
 				LED_FLASH(GREEN_LED);
 
-				// Send data to Python UART polling program
-				vUSCI_A0_UART_SendBytes(g_ucaRXInput, 2);
+				if ( g_ucaRXPacket[PKT_TYPE] == PKT_CAPTURE )
+				{
+					// The waveform goes to the PC once all of it is in
+					vStoreFragment(ulTimestamp);
+				}
+				else
+				{
+					// Send node, sequence number, link and readings to Python
+					// UART polling program
+					g_ucaRecord[0] = g_ucaRXPacket[PKT_ADDRESS];
+					g_ucaRecord[1] = g_ucaRXPacket[PKT_SAMPLE_SEQUENCE];
+					g_ucaRecord[2] = g_ucaRXPacket[PKT_SAMPLE_VERSION];
+					vPutLink(&g_ucaRecord[3], ulTimestamp);
+					for ( ucIndex = 0;
+					      ucIndex < REC_SAMPLE_LENGTH - 3 - REC_LINK_LENGTH;
+					      ++ucIndex )
+					{
+						g_ucaRecord[3 + REC_LINK_LENGTH + ucIndex] =
+							g_ucaRXPacket[PKT_SAMPLE_DATA + ucIndex];
+					}
+					vSendRecord(REC_SAMPLE, g_ucaRecord, REC_SAMPLE_LENGTH);
+				}
+
+				// Wait for the ACK to go out
+				ucSleepUntil(WAKE_RADIO);
 
-				// Clear the receiver buffer with strobe command
-				ucCC2500_SendCommandStrobe(SFRX);
+				// Once the ACK saying "move now" has gone out, move there too
+				if ( g_ucAnnounce && --g_ucAnnounce == 0 )
+				{
+					vCC2500_SetChannel(g_ucNextChannel);
+				}
 
-				// Enable interrupts once again
-				P2IE |= BIT6;
+#ifdef BENCHMARK
+				vBench_Stop();
+#endif
     	}
 
         // BASE code ends
@@ -177,7 +1497,7 @@ void main(void)
 				TACCTL0 |= CCIE;        // PWM mode set to reset/set mode and enable capture/compare interrupt
 
 				// Maximum value for TACCR0 in up mode (about one second)
-				TACCR0 = 14000;
+				TACCR0 = g_uiSamplePeriod;
 
 				// Set up Timer_A Control Register
 				TACTL |= TASSEL_1;    // Set Timer_A source to ACLK
@@ -201,8 +1521,16 @@ void main(void)
 				// Select /4 for divider of clock source
 				ADC10CTL1 |= ADC10DIV_3;
 
-				// Select A0 for communication with CLIO board
-				ADC10CTL1 |= INCH_0;
+				// Convert INCH_10 (temperature) down to A0 (CLIO board) in one
+				// sequence, one conversion after another
+				ADC10CTL1 |= INCH_10 + CONSEQ_1;
+				ADC10CTL0 |= MSC;
+
+				// A0 and A1 are analog inputs
+				ADC10AE0 |= BIT0 + BIT1;
+
+				// The DTC stores one word per conversion
+				ADC10DTC0 = 0;
 
 				// Vr+ = Vref+ = 1.5 V and Vr- = Vss = 0V
 				ADC10CTL0 |= SREF_1;
@@ -219,24 +1547,64 @@ void main(void)
 				// ADC10 reference-generator voltage is set to 2.5
 				ADC10CTL0 |= REF2_5V;
 
+				// Interrupt when the conversion is done
+				ADC10CTL0 |= ADC10IE;
+
 				while(1)
 				{
-					// Prepare to sample ADC
+					// Wait for the next sample period
+#ifdef CAPTURE
+					vCaptureUntilTimer();
+#else
+					ucSleepUntil(WAKE_TIMER);
+#endif
+
+#ifdef BENCHMARK
+					vBench_Start(BENCH_REMOTE_LOOP);
+#endif
+
+					// Prepare to sample ADC, the reference settles once for the
+					// whole sequence
 					ADC10CTL0 |= (REFON + ADC10ON);
+					__delay_cycles(REF_SETTLE_CYCLES);
 
-					// Sample A0 from CLIO board (solar panel)
+					// Sample every channel in one DTC block
+					ADC10DTC1 = ADC_SEQUENCE;
+					ADC10SA = (unsigned int)g_uiaADC;
 					ADC10CTL0 |= ENC + ADC10SC;
 
 					// Enter LPM3 and wait for ADC10 to finish calculations
-					__bis_SR_register(GIE+LPM3_bits);
-
-					// Store value from ADC10 in global int variable - value is only ten bits
-					g_uiSolar = ADC10MEM;
+					ucSleepUntil(WAKE_ADC);
+
+					// Store values from ADC10 - values are only ten bits
+					g_uiSolar = g_uiaADC[ADC_SLOT(ADC_VOLTAGE)];
+					uiCurrent = g_uiaADC[ADC_SLOT(ADC_CURRENT)];
+					uiTemperature = g_uiaADC[ADC_SLOT(ADC_TEMPERATURE)];
+					uiPower = uiPanelPower(g_uiSolar, uiCurrent);
+
+					// Stir the ADC noise into the jitter and pick the next
+					// period. TAR has usually only just restarted, but a long
+					// capture burst can run past the new period; the counter
+					// would then run on to 0xFFFF before wrapping, so the
+					// period is restarted instead.
+					g_uiRandom ^= g_uiSolar << 6;
+					TACCR0 = g_uiSamplePeriod - (SAMPLE_JITTER / 2) +
+					         (uiRandom() % SAMPLE_JITTER);
+					if ( TAR >= TACCR0 )
+					{
+						TACTL |= TACLR;
+					}
 
 					// Stop converting, then shutoff reference generator and ADC to save energy
 					ADC10CTL0 &= ~ENC;
 					ADC10CTL0 &= ~(REFON + ADC10ON);
 
+					g_ucaTXPacket[PKT_LENGTH] = PKT_SAMPLE_LENGTH;
+					g_ucaTXPacket[PKT_ADDRESS] = NODE_ID;
+					g_ucaTXPacket[PKT_TYPE] = PKT_SAMPLE;
+					g_ucaTXPacket[PKT_SAMPLE_SEQUENCE] = g_ucSequence++;
+					g_ucaTXPacket[PKT_SAMPLE_VERSION] = g_ucConfigVersion;
+
 					// Split the values from the ADC into two different bytes to be sent:
 
 						// Stores only the first two bits
@@ -244,7 +1612,7 @@ void main(void)
 						// 1 0 1 0 1 0 1 0 1 0
 						// |__|
 
-						g_ucaRXInput[0] = g_uiSolar >> 8;
+						g_ucaTXPacket[PKT_SAMPLE_DATA] = g_uiSolar >> 8;
 
 
 						// Stores only the last eight bits
@@ -252,43 +1620,76 @@ void main(void)
 						// 1 0 1 0 1 0 1 0 1 0
 						//     |_____________|
 
-						g_ucaRXInput[1] = (g_uiSolar & 255);
-
-					// Reset interrupt enable
-					P2IE &= ~BIT6;
-
-					// Reset interrupt flag
-					P2IFG &= ~BIT6;
+						g_ucaTXPacket[PKT_SAMPLE_DATA + 1] = (g_uiSolar & 255);
 
-					// Clear the transmit FIFO with strobe command
-					ucCC2500_SendCommandStrobe(SFTX);
-
-					// Renable interrupts
-					P2IE |= BIT6;
-
-					// Reset interrupt flag
-					P2IFG &= ~BIT6;
-
-					// Send flag
-					g_ucRXFlag = 0;
+					// The rest the same way
+					g_ucaTXPacket[PKT_SAMPLE_CURRENT] = uiCurrent >> 8;
+					g_ucaTXPacket[PKT_SAMPLE_CURRENT + 1] = uiCurrent & 255;
+					g_ucaTXPacket[PKT_SAMPLE_TEMPERATURE] = uiTemperature >> 8;
+					g_ucaTXPacket[PKT_SAMPLE_TEMPERATURE + 1] = uiTemperature & 255;
+					g_ucaTXPacket[PKT_SAMPLE_POWER] = uiPower >> 8;
+					g_ucaTXPacket[PKT_SAMPLE_POWER + 1] = uiPower & 255;
 
+					// Bring the radio back from SLEEP
+					vRadioWake();
 
+					// Recalibrate the synthesizer every so often, or now if the
+					// temperature has drifted
+					if ( (ADC10CTL0 & ADC10SHT_3) == ADC_TEMPERATURE_SHT )
+					{
+						vCC2500_CalibrationTemperature(uiTemperature);
+					}
+					vCC2500_CalibrationTick();
 
 					// Flash green LED
 					LED_FLASH(GREEN_LED);
 
-					// Send the 16-bit array (with only 10-bits possible of actual data from ADC10)
-					ucCC2500_BurstWriteRegisters(TX_FIFO, g_ucaRXInput, 2);
-
-					// Send strobe command to send data to BASE
-					ucCC2500_SendCommandStrobe(STX);
-
-					// Enter sleep mode until finished and ready to sample ADC10 again
-					__bis_SR_register(GIE+LPM3_bits);
-
-					// Data is received so disable interrupts
-					P2IE &= ~BIT6;
-
+					// Send the sample packet
+					vSendPacket(g_ucaTXPacket);
+
+					// Enter sleep mode until finished, the radio then listens for the ACK
+					ucSleepUntil(WAKE_RADIO);
+
+					// Give the BASE a moment to ACK
+					if ( ucWaitForAck() )
+					{
+						g_ucMissedAcks = 0;
+
+						// Follow the BASE if it is moving to a new channel
+						vFollowBase();
+
+						// Pick up a new configuration if one came along
+						vApplyConfig();
+					}
+					else
+					{
+						++g_uiAcksMissed;
+
+						// The BASE may have moved without us hearing about it.
+						// Try the channel it announced first, if any, then the
+						// next candidate channel every sample until an ACK
+						// comes back.
+						if ( ++g_ucMissedAcks >= LINK_LOSS_LIMIT )
+						{
+							g_ucMissedAcks = LINK_LOSS_LIMIT;
+							if ( g_ucPendingChannel )
+							{
+								vHopTo(g_ucPendingChannel);
+								g_ucPendingChannel = 0;
+							}
+							else
+							{
+								vHopTo(g_ucaChannels[(g_ucHopIndex + 1) % CHANNEL_COUNT]);
+							}
+						}
+					}
+
+					// Radio sleeps until the next sample
+					vRadioSleep();
+
+#ifdef BENCHMARK
+					vBench_Stop();
+#endif
 				}
 		// REMOTE code ends
 		#endif
@@ -305,27 +1706,44 @@ void main(void)
 #pragma vector=PORT2_VECTOR
 __interrupt void vPort2_ISR()
 {
-    unsigned char ucLength = 0x00;
+#ifdef BENCHMARK
+    BENCH_ISR_START();
+#endif
+
     if ( g_ucRXFlag ) // If in RX mode
     {
-        ucCC2500_ReadSingleRegister( RXBYTES, &ucLength );
-        if ( ucLength )
-        {
-        // CRC has passed and hence packet is valid, so wake up on exit
-        __bic_SR_register_on_exit( LPM3_bits );
-        }
+#ifdef BASE
+        // Timestamp first, so the latency of the rest doesn't show up in it
+        g_ulRXTimestamp = ulTicks();
+#endif
+
+        // GDO2 is CRC OK, so there is no need to read RXBYTES over the SPI.
+        // On a bad CRC the packet was autoflushed and the radio is in IDLE,
+        // wake up anyway so the main loop can go back to RX
+        g_ucRXPacketOK = ( P2IN & BIT7 ) ? 1 : 0;
+        vCC2500_TrackPacketEnd( g_ucRXPacketOK ? STATUS_FIFO_BYTES : 0 );
     }
-    // If in TX mode, we are done sending the packet, so wake on exit
     else
     {
-    __bic_SR_register_on_exit( LPM3_bits );
+        // If in TX mode, we are done sending the packet and MCSM1 has put
+        // the radio in RX
+        vCC2500_TrackPacketEnd( 0 );
+        g_ucRXFlag = 1;
+        g_ucRXPacketOK = 0;
     }
+    g_ucWakeEvents |= WAKE_RADIO;
+    __bic_SR_register_on_exit( LPM3_bits );
 
     P2IFG &= ~BIT6; // Clear interrupt flag so the interrupt can be called again
 
+#ifdef BENCHMARK
+    BENCH_ISR_END();
+#endif
 }
 
 
+#ifdef REMOTE
+
 //**************************************************************************/
 // TIMERA0 Interrupt Service Routine
 // With TACCR0 = 14000 on VLO, this is about one second
@@ -334,9 +1752,55 @@ __interrupt void vPort2_ISR()
 #pragma vector = TIMERA0_VECTOR;
 __interrupt void Timer_A (void)
 {
+	g_ucWakeEvents |= WAKE_TIMER;
 	_bic_SR_register_on_exit(LPM3_bits);
 }
 
+#endif
+
+
+//**************************************************************************/
+// TIMERA1 Interrupt Service Routine
+// REMOTE: TACCR1 is the ACK timeout. If the sync word has already come in
+// (GDO0 is high) the packet is on its way, so the timeout is moved on by
+// RX_TIMEOUT, once, to give the end of packet time to show up. Should it
+// never come the next match ends the wait, rather than one a whole period
+// later.
+// BASE: counts Timer_A overflows for ulTicks()
+//**************************************************************************/
+
+#pragma vector = TIMERA1_VECTOR
+__interrupt void Timer_A1 (void)
+{
+	switch ( __even_in_range(TAIV, 10) )
+	{
+#ifdef REMOTE
+		case 2:
+			if ( (P2IN & BIT6) && !g_ucTimeoutMoved )
+			{
+				vSetTimeout(RX_TIMEOUT);
+				g_ucTimeoutMoved = 1;
+			}
+			else
+			{
+				TACCTL1 = 0;
+				g_ucWakeEvents |= WAKE_TIMEOUT;
+				_bic_SR_register_on_exit(LPM3_bits);
+			}
+			break;
+#endif
+#ifdef BASE
+		case 10:
+			++g_uiTickOverflows;
+			break;
+#endif
+		default:
+			break;
+	}
+}
+
+
+#ifdef REMOTE
 
 //**************************************************************************/
 // ADC10 Interrupt Service Routine
@@ -347,5 +1811,24 @@ __interrupt void Timer_A (void)
 #pragma vector=ADC10_VECTOR
 __interrupt void ADC10_ISR (void)
 {
+#ifdef CAPTURE
+    // A block of the capture ring is full. Point the DTC at the next one,
+    // unless the blocks after the trigger are all in.
+    if ( g_ucCapturing )
+    {
+        if ( ++g_uiCaptureFilled == g_uiCaptureStopAt )
+        {
+            ADC10CTL0 &= ~ENC;
+        }
+        else
+        {
+            ADC10SA = (unsigned int)&g_uiaCapture[(g_uiCaptureFilled % CAPTURE_BLOCKS) *
+                                                  CAPTURE_BLOCK];
+        }
+    }
+#endif
+    g_ucWakeEvents |= WAKE_ADC;
     __bic_SR_register_on_exit(LPM3_bits);        // Clear CPUOFF bit from 0(SR)
 }
+
+#endif
@@ -0,0 +1,85 @@
+//******************************************************************************
+// packet.h
+//
+// Northern Arizona University
+//
+// Layout of the packets sent between the REMOTEs and the BASE. The CC2500 is
+// in variable length mode, so the first byte of every packet is the number of
+// bytes that follow it. Next is the node address of the REMOTE the packet is
+// from or for (the BASE is always PKT_BASE_ADDRESS), then the packet type.
+//******************************************************************************
+
+#ifndef _PACKET_H_
+  #define _PACKET_H_
+
+  // Offsets into a packet buffer
+  #define    PKT_LENGTH        0
+  #define    PKT_ADDRESS       1
+  #define    PKT_TYPE          2
+  #define    PKT_PAYLOAD       3
+
+  #define    PKT_BASE_ADDRESS  0x00
+
+  // Only used in BASE configuration slots, means every REMOTE
+  #define    PKT_BROADCAST     0xFF
+
+  // Largest packet (including the length byte) either side will accept
+  #define    PKT_BUFFER_SIZE   0x20
+
+  // The radio appends two status bytes to every packet it receives. They are
+  // read into the buffer after the last byte: RSSI (signed, 0.5 dB steps),
+  // then LQI with CRC OK in bit 7.
+  #define    PKT_STATUS_LENGTH 2
+
+  // Packet types
+  #define    PKT_SAMPLE        0x01  // REMOTE -> BASE
+  #define    PKT_ACK           0x02  // BASE -> REMOTE
+  #define    PKT_CAPTURE       0x03  // REMOTE -> BASE
+
+  // PKT_SAMPLE payload: sequence number, version of the configuration the
+  // REMOTE is running, then the readings from one ADC10 sequence, each MSB
+  // first: panel voltage, panel current and temperature sensor in ADC10
+  // counts, and the panel power the REMOTE worked out from them in mW
+  #define    PKT_SAMPLE_SEQUENCE     (PKT_PAYLOAD + 0)
+  #define    PKT_SAMPLE_VERSION      (PKT_PAYLOAD + 1)
+  #define    PKT_SAMPLE_DATA         (PKT_PAYLOAD + 2)
+  #define    PKT_SAMPLE_CURRENT      (PKT_PAYLOAD + 4)
+  #define    PKT_SAMPLE_TEMPERATURE  (PKT_PAYLOAD + 6)
+  #define    PKT_SAMPLE_POWER        (PKT_PAYLOAD + 8)
+
+  // PKT_ACK payload: channel to be on and, if that is not the current one,
+  // how many more ACKs the BASE sends before it moves there (0 = this is the
+  // last one, move now). Optionally followed by a new configuration for the
+  // REMOTE. A REMOTE only applies a configuration whose version differs from
+  // the one it runs, so resending is harmless.
+  #define    PKT_ACK_CHANNEL      (PKT_PAYLOAD + 0)
+  #define    PKT_ACK_SWITCH       (PKT_PAYLOAD + 1)
+  #define    PKT_ACK_VERSION      (PKT_PAYLOAD + 2)
+  #define    PKT_ACK_PERIOD       (PKT_PAYLOAD + 3)  // VLO ticks, MSB first
+  #define    PKT_ACK_TX_POWER     (PKT_PAYLOAD + 5)  // PATABLE value
+  #define    PKT_ACK_ADC_SHT      (PKT_PAYLOAD + 6)  // ADC10SHT_x, 0 to 3
+  #define    PKT_ACK_LEVEL        (PKT_PAYLOAD + 7)  // capture trigger level,
+                                                   //  ADC10 counts / 4
+  #define    PKT_ACK_SLOPE        (PKT_PAYLOAD + 8)  // capture trigger slope,
+                                                   //  ADC10 counts
+
+  // PKT_CAPTURE payload: one fragment of a transient capture. A capture is
+  // PKT_CAPTURE_SAMPLES ADC10 samples sent as PKT_CAPTURE_FRAGMENTS packets
+  // numbered from 0, each ACKed like a sample. Every fragment carries the
+  // capture number and the index of the sample that fired the trigger.
+  #define    PKT_CAPTURE_ID       (PKT_PAYLOAD + 0)
+  #define    PKT_CAPTURE_FRAGMENT (PKT_PAYLOAD + 1)
+  #define    PKT_CAPTURE_TRIGGER  (PKT_PAYLOAD + 2)
+  #define    PKT_CAPTURE_DATA     (PKT_PAYLOAD + 3)  // samples, MSB first
+
+  #define    PKT_CAPTURE_SAMPLES      64
+  #define    PKT_FRAGMENT_SAMPLES     8
+  #define    PKT_CAPTURE_FRAGMENTS    (PKT_CAPTURE_SAMPLES / PKT_FRAGMENT_SAMPLES)
+
+  // Value of the length byte for each type
+  #define    PKT_SAMPLE_LENGTH        12
+  #define    PKT_ACK_LENGTH           4
+  #define    PKT_ACK_CONFIG_LENGTH    11
+  #define    PKT_CAPTURE_LENGTH       (PKT_CAPTURE_DATA - 1 + 2 * PKT_FRAGMENT_SAMPLES)
+
+#endif /*_PACKET_H_*/
@@ -0,0 +1,81 @@
+//******************************************************************************
+// record.h
+//
+// Northern Arizona University
+//
+// Layout of the records the BASE sends to the PC over the UART. Every record
+// is framed so the host can find the start of the next one after a dropped
+// byte:
+//
+//   REC_SYNC, type, length, payload[length], checksum
+//
+// The checksum is the 8-bit sum of the type, length and payload bytes.
+//
+// Commands from the PC to the BASE are framed the same way, and the BASE
+// answers every one with a REC_REPLY record.
+//******************************************************************************
+
+#ifndef _RECORD_H_
+  #define _RECORD_H_
+
+  #define    REC_SYNC            0xA5
+
+  // Bytes a record adds around its payload
+  #define    REC_OVERHEAD        4
+
+  // Record types
+  #define    REC_SAMPLE          0x01  // node, sequence, configuration version,
+                                     //  link, voltage, current, temperature,
+                                     //  power as in PKT_SAMPLE
+  #define    REC_REPLY           0x02  // command type, REPLY_xxx status
+  #define    REC_WAVEFORM        0x03  // node, capture number, trigger index,
+                                     //  link (of the last fragment),
+                                     //  PKT_CAPTURE_SAMPLES ADC10 samples
+                                     //  MSB first
+  #define    REC_DIAG            0x04  // stack high water, stack size, UART
+                                     //  RX overruns, CRC errors, radio SPI
+                                     //  transactions saved, each MSB first
+
+  // Link information in the records from a packet: the BASE tick count when
+  // the packet ended (32 bits, MSB first, Timer_A on the VLO at about 12 kHz),
+  // then the RSSI (signed, 0.5 dB steps) and LQI (lower is better) the radio
+  // measured
+  #define    REC_LINK_LENGTH     6
+
+  // Payload length for each type
+  #define    REC_SAMPLE_LENGTH   17
+  #define    REC_REPLY_LENGTH    2
+  #define    REC_DIAG_LENGTH     10
+  #define    REC_WAVEFORM_LENGTH (9 + 2 * PKT_CAPTURE_SAMPLES)  // packet.h
+
+  // Commands
+  #define    CMD_SET_TX_POWER    0x81  // PATABLE value for the BASE
+  #define    CMD_SET_CHANNEL     0x82  // channel to move the network to, one
+                                     //  of g_ucaChannels in main.c; with
+                                     //  no payload, back to automatic
+  #define    CMD_SET_NODE_CONFIG 0x83  // node (PKT_BROADCAST for all),
+                                     //  version, sample period MSB first,
+                                     //  TX power, ADC10SHT_x, capture
+                                     //  level / 4, capture slope (0 = off)
+  #define    CMD_GET_DIAG        0x84  // no payload, answered with a REC_DIAG
+                                     //  before the REC_REPLY
+
+  #define    CMD_NODE_CONFIG_LENGTH  8
+
+  // Sample periods a REMOTE will accept, in VLO ticks. The shortest still
+  // fits a sample and the wait for its ACK, the longest leaves room for the
+  // jitter without TACCR0 wrapping (see SAMPLE_JITTER in main.c). Version 0
+  // is what a REMOTE runs out of reset, so it can't be sent.
+  #define    CONFIG_MIN_PERIOD   6144
+  #define    CONFIG_MAX_PERIOD   0xFDFF
+
+  // Longest command payload the BASE will accept
+  #define    CMD_MAX_LENGTH      8
+
+  // Status in a REC_REPLY
+  #define    REPLY_OK            0x00
+  #define    REPLY_BAD_CHECKSUM  0x01
+  #define    REPLY_BAD_COMMAND   0x02
+  #define    REPLY_QUEUE_FULL    0x03
+
+#endif /*_RECORD_H_*/
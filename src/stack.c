@@ -0,0 +1,74 @@
+//******************************************************************************
+// stack.c
+//
+// Northern Arizona University
+//
+// The stack is the .stack section the linker puts at the top of RAM,
+// __STACK_SIZE bytes ending at __STACK_END. At boot everything below the
+// stack pointer is painted with STACK_PAINT. The lowest word that no longer
+// holds the paint is the deepest the stack has been since.
+//******************************************************************************
+
+#include <msp430x22x4.h>
+
+#include "stack.h"
+
+// Defined by the linker, only their addresses mean anything
+extern unsigned int __STACK_END;
+extern unsigned int __STACK_SIZE;
+
+//////////////////////////////////////////////////////////////////////////////
+// puiStack_Bottom()
+//
+// Lowest word of the stack
+//////////////////////////////////////////////////////////////////////////////
+static unsigned int * puiStack_Bottom()
+{
+	return (unsigned int *)((unsigned int)&__STACK_END -
+	                        (unsigned int)&__STACK_SIZE);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// vStack_Paint()
+//
+// Paints the stack below the stack pointer. Call first thing in main, while
+// interrupts are still off.
+//////////////////////////////////////////////////////////////////////////////
+void vStack_Paint()
+{
+	unsigned int * puiWord = puiStack_Bottom();
+	unsigned int * puiTop = (unsigned int *)__get_SP_register();
+	
+	while (puiWord < puiTop)
+	{
+		*puiWord++ = STACK_PAINT;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// uiStack_Size()
+//
+// Size of the stack in bytes
+//////////////////////////////////////////////////////////////////////////////
+unsigned int uiStack_Size()
+{
+	return (unsigned int)&__STACK_SIZE;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// uiStack_HighWater()
+//
+// Most stack used since boot, in bytes. If it is uiStack_Size() the stack
+// has most likely run over into the variables below it.
+//////////////////////////////////////////////////////////////////////////////
+unsigned int uiStack_HighWater()
+{
+	const unsigned int * puiWord = puiStack_Bottom();
+	const unsigned int * puiEnd = &__STACK_END;
+	
+	while (puiWord < puiEnd && *puiWord == STACK_PAINT)
+	{
+		++puiWord;
+	}
+	return (unsigned int)((const char *)puiEnd - (const char *)puiWord);
+}
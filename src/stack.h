@@ -0,0 +1,20 @@
+//******************************************************************************
+// stack.h
+//
+// Northern Arizona University
+//
+// Stack painting, to see how close the stack has come to the variables in
+// the 1 KB of RAM
+//******************************************************************************
+
+#ifndef _STACK_H_
+  #define _STACK_H_
+
+  void vStack_Paint();
+  unsigned int uiStack_Size();
+  unsigned int uiStack_HighWater();
+
+  // Written over the unused stack at boot
+  #define    STACK_PAINT     0xA55A
+
+#endif /*_STACK_H_*/
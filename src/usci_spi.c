@@ -14,6 +14,9 @@
 
 #include <msp430x22x4.h>
 
+// Running count of bytes sent, used for benchmarking
+unsigned int g_uiUSCI_B0_ByteCount = 0;
+
 //////////////////////////////////////////////////////////////////////////////
 // USCI_B0_SPI_Init()
 //
@@ -46,10 +49,11 @@ void vUSCI_B0_SPI_Init()
 // Sends bytes on the SPI; received bytes are stored in the
 // ptrToRX. If ptrToRX is 0, then discard received data
 //////////////////////////////////////////////////////////////////////////////
-void vUSCI_B0_SPI_SendBytes( unsigned char * pucTX,
+void vUSCI_B0_SPI_SendBytes( const unsigned char * pucTX,
                              unsigned char * pucRX,
                              unsigned char ucByteCount )
 {
+	g_uiUSCI_B0_ByteCount += ucByteCount;
 	for ( ; ucByteCount > 0; --ucByteCount )
 	{
 		while( (IFG2 & UCB0TXIFG) != 0x08 );
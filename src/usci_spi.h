@@ -15,8 +15,11 @@
   #define _USCI_SPI_H_
   
   void vUSCI_B0_SPI_Init();
-  void vUSCI_B0_SPI_SendBytes(unsigned char * pucTX,
+  void vUSCI_B0_SPI_SendBytes(const unsigned char * pucTX,
                               unsigned char * pucRX,
                               unsigned char ucByteCount);
+  
+  // Bytes clocked out on the SPI since reset, wraps at 0xFFFF
+  extern unsigned int g_uiUSCI_B0_ByteCount;
 
 #endif /*_USCI_SPI_H_*/
@@ -5,15 +5,24 @@
 //
 // Uses Universal Serial Communication Interfaces (USCI) to communicate between the 
 //  eZ430 development tool and the host PC. This file implements the functionality for 
-//  the three functions defined in 'usci_uart.h'
-// The functions allow initialization of the MSP430 USCI registers, clearing of the
-//  receive buffer, and the sending of data from eZ430 to PC.
+//  the functions defined in 'usci_uart.h'
+// The functions allow initialization of the MSP430 USCI registers, reading and
+//  clearing of the receive buffer, and the sending of data from eZ430 to PC.
+// Received bytes are put in a ring buffer by the RX ISR at the bottom.
 // *************************************************************************************
 
 #include <msp430x22x4.h>
 
-unsigned char g_ucaUSCI_A0_RXBuffer[0x100];
-unsigned char g_ucUSCI_A0_RXBufferIndex;
+#include "usci_uart.h"
+
+// The ISR only moves the head and the application only moves the tail, so
+//  neither side needs to disable interrupts
+unsigned char g_ucaUSCI_A0_RXBuffer[UART_RX_BUFFER_SIZE];
+volatile unsigned char g_ucUSCI_A0_RXHead;
+unsigned char g_ucUSCI_A0_RXTail;
+volatile unsigned char g_ucUSCI_A0_RXFlag;
+unsigned int g_uiUSCI_A0_RXOverruns = 0;
+unsigned int g_uiUSCI_A0_TXByteCount = 0;
 
 void vUSCI_A0_UART_Init()
 {
@@ -42,18 +51,46 @@ void vUSCI_A0_UART_Init()
 	UCA0ABCTL &= ~UCABDEN; // No auto-baud rate detection
 	
 	P3SEL |= (BIT4 | BIT5);// Configure pins
-    g_ucUSCI_A0_RXBufferIndex = 0x00; // Set RX index to 0x00
+    vUSCI_A0_UART_ClearRXBuffer();    // Empty the ring buffer
     UCA0CTL1 &= ~UCSWRST;  // Release from reset
 	IE2 |= UCA0RXIE;       // Enable RX interrupt	
 }
 
-void vUSCI_A0_UART_ClearRXBuffer(unsigned char ucWipeData)
+/////////////////////////////////////////////////////////////////////////
+// USCI_A0_UART_ClearRXBuffer()
+//
+// Drops everything in the RX ring buffer
+/////////////////////////////////////////////////////////////////////////
+void vUSCI_A0_UART_ClearRXBuffer()
+{
+    g_ucUSCI_A0_RXTail = g_ucUSCI_A0_RXHead;
+}
+
+/////////////////////////////////////////////////////////////////////////
+// USCI_A0_UART_RXCount()
+//
+// Returns the number of bytes waiting in the RX ring buffer
+/////////////////////////////////////////////////////////////////////////
+unsigned char ucUSCI_A0_UART_RXCount()
+{
+    return (g_ucUSCI_A0_RXHead - g_ucUSCI_A0_RXTail) & (UART_RX_BUFFER_SIZE - 1);
+}
+
+/////////////////////////////////////////////////////////////////////////
+// USCI_A0_UART_ReadByte( pucData: * uint8 )
+//
+// Takes the oldest byte out of the RX ring buffer. Returns 0 if the
+// buffer was empty.
+/////////////////////////////////////////////////////////////////////////
+unsigned char ucUSCI_A0_UART_ReadByte(unsigned char * pucData)
 {
-    for(g_ucUSCI_A0_RXBufferIndex = 0; g_ucUSCI_A0_RXBufferIndex < 0xFF; ++g_ucUSCI_A0_RXBufferIndex)
+    if (g_ucUSCI_A0_RXTail == g_ucUSCI_A0_RXHead)
     {
-        g_ucaUSCI_A0_RXBuffer[g_ucUSCI_A0_RXBufferIndex] = ucWipeData;
+        return 0;
     }
-    g_ucUSCI_A0_RXBufferIndex = 0x000;
+    *pucData = g_ucaUSCI_A0_RXBuffer[g_ucUSCI_A0_RXTail];
+    g_ucUSCI_A0_RXTail = (g_ucUSCI_A0_RXTail + 1) & (UART_RX_BUFFER_SIZE - 1);
+    return 1;
 }
 
 /////////////////////////////////////////////////////////////////////////
@@ -61,8 +98,9 @@ void vUSCI_A0_UART_ClearRXBuffer(unsigned char ucWipeData)
 //
 // Send unCount bytes pointed to by pucData on USCI_A0
 /////////////////////////////////////////////////////////////////////////
-void vUSCI_A0_UART_SendBytes( unsigned char *pucData, unsigned int unCount )
+void vUSCI_A0_UART_SendBytes( const unsigned char *pucData, unsigned int unCount )
 {
+	g_uiUSCI_A0_TXByteCount += unCount;
 	for (; unCount > 0; --unCount)
 	{
 		while (!(IFG2 & UCA0TXIFG));
@@ -70,3 +108,41 @@ void vUSCI_A0_UART_SendBytes( unsigned char *pucData, unsigned int unCount )
 		++pucData;
 	}
 }
+
+/////////////////////////////////////////////////////////////////////////
+// USCI_A0 RX Interrupt Service Routine
+//
+// Puts the received byte in the ring buffer and wakes the CPU. The
+// application picks the bytes up with ucUSCI_A0_UART_ReadByte(). When the
+// buffer is full the byte is dropped and counted. USCI_B0 (SPI) shares
+// this vector but is polled, so only USCI_A0 is handled here.
+//
+// SMCLK is off in LPM3, but the USCI turns it back on by itself for the
+// incoming character.
+/////////////////////////////////////////////////////////////////////////
+#pragma vector=USCIAB0RX_VECTOR
+__interrupt void vUSCI_A0_RX_ISR(void)
+{
+    unsigned char ucNext;
+    unsigned char ucData;
+    
+    if (IFG2 & UCA0RXIFG)
+    {
+        // Reading the buffer clears the flag
+        ucData = UCA0RXBUF;
+        ucNext = (g_ucUSCI_A0_RXHead + 1) & (UART_RX_BUFFER_SIZE - 1);
+        
+        if (ucNext == g_ucUSCI_A0_RXTail)
+        {
+            ++g_uiUSCI_A0_RXOverruns;
+        }
+        else
+        {
+            g_ucaUSCI_A0_RXBuffer[g_ucUSCI_A0_RXHead] = ucData;
+            g_ucUSCI_A0_RXHead = ucNext;
+        }
+        
+        g_ucUSCI_A0_RXFlag = 1;
+        __bic_SR_register_on_exit(LPM3_bits);
+    }
+}
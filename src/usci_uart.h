@@ -12,13 +12,29 @@
   #define _USCI_UART_H_
   
   void vUSCI_A0_UART_Init();
-  void vUSCI_A0_UART_ClearRXBuffer(unsigned char ucWipeData);
+  void vUSCI_A0_UART_ClearRXBuffer();
+  unsigned char ucUSCI_A0_UART_RXCount();
+  unsigned char ucUSCI_A0_UART_ReadByte(unsigned char * pucData);
   void vUSCI_A0_UART_SendBytes(const unsigned char * pucData, 
                                unsigned int unCount);
   
+  // Size of the RX ring buffer, must be a power of two. One slot is always
+  //  left empty, so it holds one byte less than this.
+  #define UART_RX_BUFFER_SIZE 0x20
+  
   // These are used by the USCI_A0 RX ISR for storing incoming characters.
   //  See the ISR for more details (usci_uart.c)
-  extern unsigned char g_ucaUSCI_A0_RXBuffer[0x100];
-  extern unsigned char g_ucUSCI_A0_RXBufferIndex;
+  extern unsigned char g_ucaUSCI_A0_RXBuffer[UART_RX_BUFFER_SIZE];
+  extern volatile unsigned char g_ucUSCI_A0_RXHead;
+  extern unsigned char g_ucUSCI_A0_RXTail;
+  
+  // Set by the RX ISR whenever a byte arrives, cleared by the application
+  extern volatile unsigned char g_ucUSCI_A0_RXFlag;
+  
+  // Bytes dropped because the ring buffer was full
+  extern unsigned int g_uiUSCI_A0_RXOverruns;
+  
+  // Bytes sent since reset, wraps at 0xFFFF
+  extern unsigned int g_uiUSCI_A0_TXByteCount;
 
 #endif /*_USCI_UART_H_*/
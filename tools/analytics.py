@@ -0,0 +1,289 @@
+#!/usr/bin/env python
+#******************************************************************************
+# analytics.py
+#
+# Northern Arizona University
+#
+# Rolling statistics and underperformance flags for every panel, fed by the
+# REC_SAMPLE records from the BASE (see src/record.h). Needs numpy.
+#
+#   python tools/analytics.py run /dev/pts/3 --window 300
+#   python tools/analytics.py bench --nodes 10000 --threads 4
+#
+# Each panel keeps its last WINDOW power readings. From them come the rolling
+# mean and the 10th/50th/90th percentiles. All panels see the same sun, so
+# a panel's expected output is the fleet median of the rolling means (scaled
+# by the panel's rating, 1 for all by default). A panel with a full window
+# whose mean is under UNDER_RATIO of what is expected is flagged.
+#
+# State is kept as one array per statistic (struct of arrays), with a row per
+# panel, and updates are whole-array numpy operations. Panels are split into
+# shards by node number and the shards are updated on a thread pool. numpy
+# lets go of the GIL for the array work, so the shards run side by side.
+# The bench mode feeds synthetic samples and reports updates per second.
+#******************************************************************************
+
+import argparse
+import os
+import sys
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from uart_replay import split_records, REC_SAMPLE
+
+# Offsets into the REC_SAMPLE payload (after the sync, type and length)
+SAMPLE_NODE = 0
+SAMPLE_POWER = 15
+SAMPLE_LENGTH = 17
+
+UNDER_RATIO = 0.8
+PERCENTILES = (10, 50, 90)
+
+
+class Shard(object):
+	# The panels whose node number is SHARD modulo the shard count, row
+	# node // shards
+
+	def __init__(self, rows, window):
+		self.window = window
+		self.power = np.zeros((rows, window), np.float32)
+		self.head = np.zeros(rows, np.int32)
+		self.count = np.zeros(rows, np.int32)
+		self.total = np.zeros(rows, np.float64)
+
+	def _update_unique(self, rows, values):
+		# ROWS holds no duplicates, so every row gets one reading
+		head = self.head[rows]
+		full = self.count[rows] == self.window
+		self.total[rows] += values - np.where(full, self.power[rows, head], 0)
+		self.power[rows, head] = values
+		self.head[rows] = (head + 1) % self.window
+		self.count[rows] = np.minimum(self.count[rows] + 1, self.window)
+
+	def update(self, rows, values):
+		if len(rows) == 0:
+			return
+
+		# Readings for the same panel go in one after another, so split the
+		# batch into rounds with each panel in a round at most once
+		order = np.argsort(rows, kind='stable')
+		rows = rows[order]
+		values = values[order]
+		starts = np.flatnonzero(np.r_[True, rows[1:] != rows[:-1]])
+		sizes = np.diff(np.r_[starts, len(rows)])
+		rank = np.arange(len(rows)) - np.repeat(starts, sizes)
+
+		for level in range(int(sizes.max())):
+			chosen = rank == level
+			self._update_unique(rows[chosen], values[chosen])
+
+	def mean(self):
+		return self.total / np.maximum(self.count, 1)
+
+	def full(self):
+		return self.count == self.window
+
+
+class Engine(object):
+
+	def __init__(self, nodes, window, shards=1, threads=1):
+		self.nodes = nodes
+		self.shards = [Shard((nodes + shards - 1) // shards, window)
+		               for shard in range(shards)]
+		self.rating = np.ones(nodes, np.float64)
+		self.pool = ThreadPoolExecutor(threads) if threads > 1 else None
+
+	def update(self, nodes, values):
+		# NODES and VALUES are arrays of the same length, one reading each
+		count = len(self.shards)
+		shard = nodes % count
+		order = np.argsort(shard, kind='stable')
+		bounds = np.searchsorted(shard[order], np.arange(count + 1))
+		jobs = [(self.shards[index],
+		         nodes[order[bounds[index]:bounds[index + 1]]] // count,
+		         values[order[bounds[index]:bounds[index + 1]]].astype(np.float32))
+		        for index in range(count)]
+
+		if self.pool:
+			list(self.pool.map(lambda job: job[0].update(job[1], job[2]), jobs))
+		else:
+			for job in jobs:
+				job[0].update(job[1], job[2])
+
+	def _gather(self, method):
+		# Puts a per-shard array back into node order
+		result = np.zeros(self.nodes)
+		count = len(self.shards)
+		for index, shard in enumerate(self.shards):
+			values = getattr(shard, method)()
+			nodes = np.arange(len(values)) * count + index
+			keep = nodes < self.nodes
+			result[nodes[keep]] = values[keep]
+		return result
+
+	def report(self):
+		# Returns mean, expected, flagged and the percentiles (a row per
+		# PERCENTILES entry, NaN until a panel's window is full) per node
+		mean = self._gather('mean')
+		full = self._gather('full').astype(bool)
+
+		expected = np.zeros(self.nodes)
+		if full.any():
+			expected = self.rating * np.median(mean[full] / self.rating[full])
+		flagged = full & (mean < UNDER_RATIO * expected)
+
+		percentiles = np.full((len(PERCENTILES), self.nodes), np.nan)
+		count = len(self.shards)
+		for index, shard in enumerate(self.shards):
+			rows = np.flatnonzero(shard.full())
+			nodes = rows * count + index
+			keep = nodes < self.nodes
+			if keep.any():
+				percentiles[:, nodes[keep]] = np.percentile(
+					shard.power[rows[keep]], PERCENTILES, axis=1)
+
+		return mean, expected, flagged, percentiles
+
+
+def read_port(path):
+	# Yields (time, bytes) as they come in from a serial port or pty. A
+	# serial read comes back empty whenever the line has been quiet for the
+	# timeout, so only the end of a file or pty ends the stream.
+	try:
+		import serial
+		port = serial.Serial(path, 9600, timeout=0.1)
+	except (ImportError, ValueError, OSError):
+		port = None
+
+	if port is not None:
+		while True:
+			data = port.read(256)
+			if data:
+				yield time.time(), data
+
+	fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+	while True:
+		try:
+			data = os.read(fd, 4096)
+		except OSError:
+			return
+		if not data:
+			return
+		yield time.time(), data
+
+
+def print_flags(engine):
+	mean, expected, flagged, percentiles = engine.report()
+	for node in np.flatnonzero(flagged):
+		print('node %3d under: mean %.1f mW, expected %.1f mW, '
+		      'p10/p50/p90 %.0f/%.0f/%.0f' %
+		      ((node, mean[node], expected[node]) +
+		       tuple(percentiles[:, node])))
+	sys.stdout.flush()
+
+
+def run(args):
+	engine = Engine(256, args.window, args.shards, args.threads)
+	nodes = []
+	values = []
+	next_report = time.time() + args.report
+
+	for stamp, frame in split_records(read_port(args.port)):
+		if frame[1] == REC_SAMPLE and frame[2] == SAMPLE_LENGTH:
+			payload = frame[3:-1]
+			nodes.append(payload[SAMPLE_NODE])
+			values.append((payload[SAMPLE_POWER] << 8) |
+			              payload[SAMPLE_POWER + 1])
+
+		if time.time() >= next_report:
+			next_report += args.report
+			engine.update(np.array(nodes, np.int64), np.array(values))
+			nodes = []
+			values = []
+			print_flags(engine)
+
+	# The port closed or the file ended
+	engine.update(np.array(nodes, np.int64), np.array(values))
+	print_flags(engine)
+	return 0
+
+
+def bench(args):
+	rng = np.random.default_rng(1)
+	engine = Engine(args.nodes, args.window, args.shards, args.threads)
+
+	# Every panel sees the same sun, a few are shaded
+	health = np.where(rng.random(args.nodes) < 0.05, 0.6, 1.0)
+	batches = []
+	for batch in range(8):
+		nodes = rng.integers(0, args.nodes, args.batch)
+		values = (500 * health[nodes] *
+		          (1 + 0.05 * rng.standard_normal(args.batch)))
+		batches.append((nodes, values))
+
+	# Fill every window first so the timed part is steady state
+	warm = 0
+	while warm < args.nodes * args.window * 2:
+		nodes, values = batches[warm // args.batch % len(batches)]
+		engine.update(nodes, values)
+		warm += args.batch
+
+	start = time.time()
+	done = 0
+	while done < args.updates:
+		nodes, values = batches[done // args.batch % len(batches)]
+		engine.update(nodes, values)
+		done += args.batch
+	elapsed = time.time() - start
+
+	report_start = time.time()
+	mean, expected, flagged, percentiles = engine.report()
+	report_time = time.time() - report_start
+
+	caught = np.count_nonzero(flagged & (health < 1))
+	rate = done / elapsed
+	print('%d nodes, window %d, %d shards on %d threads' %
+	      (args.nodes, args.window, args.shards, args.threads))
+	print('%.0f updates/s, %.0fx real time at one sample per node per '
+	      'second' % (rate, rate / args.nodes))
+	print('report in %.3f s, %d of %d shaded panels flagged, %d false' %
+	      (report_time, caught, np.count_nonzero(health < 1),
+	       np.count_nonzero(flagged) - caught))
+	return 0
+
+
+def main(argv):
+	# Engine options, taken after either command
+	engine = argparse.ArgumentParser(add_help=False)
+	engine.add_argument('--window', type=int, default=300,
+	                    help='readings per panel in the window')
+	engine.add_argument('--shards', type=int, default=4)
+	engine.add_argument('--threads', type=int, default=4)
+
+	parser = argparse.ArgumentParser(description='Per-panel rolling analytics')
+	commands = parser.add_subparsers(dest='command')
+	commands.required = True
+
+	live = commands.add_parser('run', parents=[engine],
+	                           help='analyse records from the BASE')
+	live.add_argument('port')
+	live.add_argument('--report', type=float, default=10,
+	                  help='seconds between reports')
+	live.set_defaults(run=run)
+
+	timing = commands.add_parser('bench', parents=[engine],
+	                             help='time the engine')
+	timing.add_argument('--nodes', type=int, default=10000)
+	timing.add_argument('--batch', type=int, default=65536)
+	timing.add_argument('--updates', type=int, default=10000000)
+	timing.set_defaults(run=bench)
+
+	args = parser.parse_args(argv[1:])
+	return args.run(args)
+
+
+if __name__ == '__main__':
+	sys.exit(main(sys.argv))
@@ -0,0 +1,150 @@
+#!/usr/bin/env python
+#******************************************************************************
+# bench_check.py
+#
+# Northern Arizona University
+#
+# Checks the JSON results a benchmark image prints (see src/bench.c) against a
+# baseline recorded from a known-good run, and exits with 1 on a regression:
+#
+#   python tools/bench_check.py bench-base.log --image base
+#   python tools/bench_check.py bench-remote.log --image remote --record
+#
+# The log is whatever came off the UART. The BASE sends binary records on
+# the same line as its results, so results are picked out wherever they
+# start. A benchmark usually runs many times (the loops run every sample),
+# so the median of each number is what gets compared. Cycles, energy and air
+# time may grow by --threshold percent, SPI bytes must not grow at all.
+#
+# The baseline holds one set of benchmarks per image. A benchmark missing
+# from the baseline, or a baseline benchmark missing from the log, is a
+# failure too. Record a baseline with --record from a run that is known to
+# be good and commit the file.
+#******************************************************************************
+
+import argparse
+import json
+import os
+import sys
+
+BASELINE = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        'bench_baseline.json')
+
+# Numbers compared against the baseline, and how much each may grow in percent
+# (None means by --threshold)
+CHECKED = (
+	('cycles', None),
+	('energy_uj', None),
+	('airtime_us', None),
+	('spi', 0),
+)
+
+
+RESULT_START = '{"bench"'
+
+
+def read_log(path):
+	# Returns {bench: {number: [values]}}
+	text = open(path, 'rb').read().decode('latin-1')
+	decoder = json.JSONDecoder()
+	runs = {}
+	start = text.find(RESULT_START)
+	while start >= 0:
+		try:
+			result, end = decoder.raw_decode(text, start)
+		except ValueError:
+			start = text.find(RESULT_START, start + 1)
+			continue
+		start = text.find(RESULT_START, end)
+		numbers = runs.setdefault(result['bench'], {})
+		for name, value in result.items():
+			if name != 'bench':
+				numbers.setdefault(name, []).append(value)
+	return runs
+
+
+def median(values):
+	values = sorted(values)
+	return values[len(values) // 2]
+
+
+def summarize(runs):
+	return dict((bench, dict((name, median(values))
+	                         for name, values in numbers.items()))
+	            for bench, numbers in runs.items())
+
+
+def main(argv):
+	parser = argparse.ArgumentParser(description='Benchmark regression check')
+	parser.add_argument('log', help='UART output of a benchmark image')
+	parser.add_argument('--image', default='base', choices=('base', 'remote'),
+	                    help='image the log came from')
+	parser.add_argument('--baseline', default=BASELINE)
+	parser.add_argument('--threshold', type=int, default=10,
+	                    help='allowed growth in percent')
+	parser.add_argument('--record', action='store_true',
+	                    help='write the run to the baseline instead')
+	args = parser.parse_args(argv[1:])
+
+	results = summarize(read_log(args.log))
+	if not results:
+		sys.stderr.write('no benchmark results in %s\n' % args.log)
+		return 2
+
+	images = {}
+	if os.path.exists(args.baseline):
+		images = json.load(open(args.baseline))
+
+	if args.record:
+		images[args.image] = results
+		with open(args.baseline, 'w') as out:
+			json.dump(images, out, indent=1, sort_keys=True)
+			out.write('\n')
+		print('%d %s benchmarks written to %s' % (len(results), args.image,
+		      args.baseline))
+		return 0
+
+	if args.image not in images:
+		sys.stderr.write('no %s baseline in %s, record one with --record\n' %
+		                 (args.image, args.baseline))
+		return 1
+	baseline = images[args.image]
+
+	failed = False
+	print('%-14s %-11s %10s %10s %7s' % ('bench', 'number', 'baseline',
+	      'now', 'change'))
+	for bench in sorted(results):
+		if bench not in baseline:
+			print('%-14s %-11s %10s %10s %7s  NO BASELINE' % (bench, '-', '-',
+			      '-', '-'))
+			failed = True
+			continue
+
+		for name, growth in CHECKED:
+			if growth is None:
+				growth = args.threshold
+			now = results[bench].get(name)
+			then = baseline[bench].get(name)
+			if now is None or then is None:
+				print('%-14s %-11s %10s %10s %7s  NO BASELINE' % (bench, name,
+				      then if then is not None else '-',
+				      now if now is not None else '-', '-'))
+				failed = True
+				continue
+
+			over = now * 100 > then * (100 + growth)
+			change = '%+.0f%%' % ((now - then) * 100.0 / then) if then else '-'
+			print('%-14s %-11s %10d %10d %7s%s' % (bench, name, then, now,
+			      change, '  OVER' if over else ''))
+			failed = failed or over
+
+	for bench in sorted(set(baseline) - set(results)):
+		print('%-14s %-11s %10s %10s %7s  MISSING' % (bench, '-', '-', '-',
+		      '-'))
+		failed = True
+
+	return 1 if failed else 0
+
+
+if __name__ == '__main__':
+	sys.exit(main(sys.argv))
@@ -0,0 +1,102 @@
+#!/usr/bin/env python
+#******************************************************************************
+# budget.py
+#
+# Northern Arizona University
+#
+# Post-build check of flash and RAM use per module against a budget. Reads the
+# MODULE SUMMARY and the .stack section from the map file the TI linker
+# writes, prints a table, and exits with 1 if any module or the whole image
+# is over budget:
+#
+#   python tools/budget.py Debug/EmbeddedWirelessSolarMonitor.map
+#
+# Flash is code plus read-only data, RAM is read-write data. The stack comes
+# out of the same 1 KB of RAM, so it is added to the RAM total. How much of
+# the stack is really used is measured on the board, see src/stack.c.
+#******************************************************************************
+
+import re
+import sys
+
+# MSP430F2274
+FLASH_SIZE = 32768
+RAM_SIZE = 1024
+
+# Bytes of flash and RAM each module may use. Modules not listed (the run
+# time library) only count towards the totals.
+BUDGET = {
+	'main':      (8192, 448),
+	'cc2500':    (3072, 64),
+	'usci_spi':  (256,  8),
+	'usci_uart': (768,  48),
+	'bench':     (2048, 48),
+	'stack':     (256,  0),
+}
+
+
+def read_map(path):
+	modules = {}
+	stack = 0
+	in_summary = False
+
+	for line in open(path):
+		if line.startswith('MODULE SUMMARY'):
+			in_summary = True
+			continue
+
+		match = re.match(r'\s*\.stack\s+\S+\s+[0-9a-fA-F]+\s+([0-9a-fA-F]+)', line)
+		if match:
+			stack = int(match.group(1), 16)
+			continue
+
+		if not in_summary:
+			continue
+
+		# "   main.obj    1234   56   78"
+		match = re.match(r'\s+(\S+)\.obj\s+(\d+)\s+(\d+)\s+(\d+)\s*$', line)
+		if match:
+			name = match.group(1)
+			code, rodata, rwdata = [int(x) for x in match.group(2, 3, 4)]
+			flash, ram = modules.get(name, (0, 0))
+			modules[name] = (flash + code + rodata, ram + rwdata)
+		elif line.strip().startswith('Grand Total'):
+			in_summary = False
+
+	return modules, stack
+
+
+def main(argv):
+	if len(argv) != 2:
+		sys.stderr.write('usage: budget.py <linker map>\n')
+		return 2
+
+	modules, stack = read_map(argv[1])
+	if not modules:
+		sys.stderr.write('no MODULE SUMMARY in %s\n' % argv[1])
+		return 2
+
+	failed = False
+	print('%-12s %7s %7s %7s %7s' % ('module', 'flash', 'budget', 'ram', 'budget'))
+	for name in sorted(modules):
+		flash, ram = modules[name]
+		if name in BUDGET:
+			flash_max, ram_max = BUDGET[name]
+			over = flash > flash_max or ram > ram_max
+			print('%-12s %7d %7d %7d %7d%s' % (name, flash, flash_max, ram,
+			      ram_max, '  OVER' if over else ''))
+			failed = failed or over
+		else:
+			print('%-12s %7d %7s %7d %7s' % (name, flash, '-', ram, '-'))
+
+	flash = sum(m[0] for m in modules.values())
+	ram = sum(m[1] for m in modules.values()) + stack
+	print('%-12s %7d %7d %7d %7d  (RAM includes %d bytes of stack)' %
+	      ('total', flash, FLASH_SIZE, ram, RAM_SIZE, stack))
+	failed = failed or flash > FLASH_SIZE or ram > RAM_SIZE
+
+	return 1 if failed else 0
+
+
+if __name__ == '__main__':
+	sys.exit(main(sys.argv))
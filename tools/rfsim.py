@@ -0,0 +1,473 @@
+#!/usr/bin/env python
+#******************************************************************************
+# rfsim.py
+#
+# Northern Arizona University
+#
+# Discrete-event simulation of many REMOTEs and one or more BASEs sharing the
+# 2.4 GHz band, for seeing how the BASE holds up as the panel count grows
+# without a bench full of boards:
+#
+#   python tools/rfsim.py --nodes 10 50 100 200 400
+#   python tools/rfsim.py --nodes 200 --period 1 0.5 --bases 2 --jobs 8
+#
+# Each line of the report is one node count and sample period: the share of
+# REMOTEs whose BASE hears them above the sensitivity, the share of all
+# samples the BASE recorded, the share the REMOTEs got an ACK for, the
+# latency from a sample being taken to its record leaving the BASE's UART,
+# the BASE CPU time, and how much faster than real time the run went.
+#
+# The medium:
+#   - Log-distance path loss with a fixed log-normal shadowing per pair of
+#     nodes, so RSSI = TX power - path loss.
+#   - A receiver in RX locks on to the first packet that starts above the
+#     sensitivity. Packets starting while it is locked are interference. The
+#     packet gets through if its power stays CAPTURE dB over the noise plus
+#     the worst interference while it is on the air (capture effect),
+#     otherwise the CRC fails. Packets on other channels don't interfere.
+#
+# The nodes do what the firmware does (src/main.c), with its timing:
+#   - A REMOTE wakes every SAMPLE_PERIOD +/- SAMPLE_JITTER / 2 VLO ticks,
+#     sends a sample from IDLE (so CCA never holds it back), and listens up
+#     to ACK_TIMEOUT for its ACK, taking in other packets on the way.
+#     --retries resends a sample that wasn't ACKed, the firmware doesn't.
+#   - A BASE goes to IDLE after every packet. After a good sample it turns
+#     around, sends the ACK (the radio goes back to RX after it) and sends
+#     the record on the UART while the ACK is on the air. The BASE is deaf
+#     from the end of the sample to the end of the ACK.
+#   - Each REMOTE talks to the BASE it hears best, each BASE has a channel
+#     of its own.
+#
+# The runs of a sweep are spread over --jobs processes.
+#******************************************************************************
+
+import argparse
+import heapq
+import math
+import multiprocessing
+import random
+import sys
+import time
+
+# From the firmware (src/main.c, src/packet.h, src/record.h, and profile 0
+# in src/cc2500.c)
+VLO_HZ = 14000.0
+SAMPLE_PERIOD = 14000
+SAMPLE_JITTER = 1024
+ACK_TIMEOUT = 3500
+BYTE_S = 8 / 1200.0
+PACKET_OVERHEAD = 8
+SAMPLE_LENGTH = 12
+ACK_LENGTH = 4
+RECORD_BYTES = 17 + 4
+UART_BYTE_S = 10 / 9600.0
+CHANNELS = (0x03, 0x23, 0x43, 0x63, 0x83, 0xA3, 0xC3, 0xE3)
+
+SAMPLE = 1
+ACK = 2
+
+
+def airtime(length):
+	# Length byte, payload, and the preamble, sync word and CRC
+	return (length + 1 + PACKET_OVERHEAD) * BYTE_S
+
+
+def dbm(mw):
+	return 10 * math.log10(mw) if mw > 0 else -999.0
+
+
+class Packet(object):
+	__slots__ = ('sender', 'channel', 'kind', 'dest', 'seq', 'taken', 'end')
+
+	def __init__(self, sender, kind, dest, seq, taken):
+		self.sender = sender
+		self.channel = sender.channel
+		self.kind = kind
+		self.dest = dest
+		self.seq = seq
+		self.taken = taken
+		self.end = 0.0
+
+
+class Node(object):
+	def __init__(self, index, x, y):
+		self.index = index
+		self.x = x
+		self.y = y
+		self.channel = None
+		self.locked = None
+		self.signal = 0.0
+		self.heard = 0.0
+		self.worst = 0.0
+		self.gains = {}
+
+
+class Remote(Node):
+	def __init__(self, index, x, y):
+		Node.__init__(self, index, x, y)
+		self.base = None
+		self.seq = 0
+		self.busy = False
+		self.pending = False
+		self.taken = 0.0
+		self.tries = 0
+		self.token = 0
+
+
+class Base(Node):
+	def __init__(self, index, x, y):
+		Node.__init__(self, index, x, y)
+		self.cpu = 0.0
+		self.last = {}
+
+
+class Sim(object):
+	def __init__(self, args, nodes, period, seed):
+		self.args = args
+		self.rng = random.Random(seed)
+		self.seed = seed
+		self.period = int(period * VLO_HZ)
+		self.events = []
+		self.order = 0
+		self.now = 0.0
+		self.air = {}
+		self.listeners = {}
+		self.noise = 10 ** (args.noise / 10.0)
+
+		self.sent = 0
+		self.delivered = 0
+		self.duplicates = 0
+		self.acked = 0
+		self.latency = []
+
+		self.bases = []
+		for index in range(args.bases):
+			if args.bases == 1:
+				x, y = 0.0, 0.0
+			else:
+				angle = 2 * math.pi * index / args.bases
+				x = args.radius / 2 * math.cos(angle)
+				y = args.radius / 2 * math.sin(angle)
+			base = Base(index, x, y)
+			base.channel = CHANNELS[index % len(CHANNELS)]
+			self.bases.append(base)
+
+		self.remotes = []
+		for index in range(nodes):
+			r = args.radius * math.sqrt(self.rng.random())
+			angle = 2 * math.pi * self.rng.random()
+			remote = Remote(args.bases + index, r * math.cos(angle),
+			                r * math.sin(angle))
+			remote.base = max(self.bases, key=lambda b: self.gain(remote, b))
+			remote.channel = remote.base.channel
+			self.remotes.append(remote)
+
+	# Events
+
+	def at(self, when, action, *args):
+		self.order += 1
+		heapq.heappush(self.events, (when, self.order, action, args))
+
+	def run(self):
+		for remote in self.remotes:
+			start = 0.0 if self.args.sync_start else \
+			        self.rng.random() * self.period / VLO_HZ
+			self.at(start, self.sample, remote)
+		for base in self.bases:
+			self.listen(base)
+
+		count = 0
+		while self.events:
+			self.now, _, action, args = heapq.heappop(self.events)
+			action(*args)
+			count += 1
+		return count
+
+	# Medium
+
+	def gain(self, a, b):
+		# Received power in mW, the same both ways
+		gain = a.gains.get(b.index)
+		if gain is None:
+			args = self.args
+			low, high = sorted((a.index, b.index))
+			d = max(math.hypot(a.x - b.x, a.y - b.y), 1.0)
+			shadow = random.Random(self.seed * 1000003 + low * 65537 +
+			                       high).gauss(0, args.shadowing)
+			loss = args.loss_1m + 10 * args.exponent * math.log10(d) + shadow
+			gain = 10 ** ((args.tx_power - loss) / 10.0)
+			a.gains[b.index] = gain
+			b.gains[a.index] = gain
+		return gain
+
+	# Every node in RX keeps the total power it hears (HEARD), updated as
+	# packets start and end, so a packet start costs one addition per
+	# listener rather than a sum over everything on the air
+
+	def listen(self, node):
+		node.locked = None
+		node.heard = sum(self.gain(packet.sender, node)
+		                 for packet in self.air.get(node.channel, ()))
+		self.listeners.setdefault(node.channel, set()).add(node)
+
+	def deafen(self, node):
+		node.locked = None
+		self.listeners.get(node.channel, set()).discard(node)
+
+	def send(self, packet, length):
+		self.deafen(packet.sender)
+		packet.end = self.now + airtime(length)
+		self.air.setdefault(packet.channel, []).append(packet)
+
+		sender = packet.sender
+		for node in self.listeners.get(packet.channel, ()):
+			gain = node.gains.get(sender.index) or self.gain(sender, node)
+			node.heard += gain
+			if node.locked is None:
+				if dbm(gain) >= self.args.sensitivity:
+					node.locked = packet
+					node.signal = gain
+					node.worst = node.heard - gain
+			else:
+				node.worst = max(node.worst, node.heard - node.signal)
+
+		self.at(packet.end, self.sent_packet, packet)
+
+	def sent_packet(self, packet):
+		self.air[packet.channel].remove(packet)
+
+		sender = packet.sender
+		ended = []
+		for node in self.listeners.get(packet.channel, ()):
+			node.heard -= node.gains.get(sender.index) or self.gain(sender, node)
+			if node.heard < 0.0:
+				node.heard = 0.0
+			if node.locked is packet:
+				ended.append(node)
+		for node in ended:
+			node.locked = None
+			good = dbm(node.signal / (self.noise + node.worst)) >= \
+			       self.args.capture
+			self.received(node, packet, good)
+
+		if packet.kind == SAMPLE:
+			self.sample_sent(packet.sender)
+		else:
+			self.listen(packet.sender)
+
+	def received(self, node, packet, good):
+		if isinstance(node, Base):
+			self.base_received(node, packet, good)
+		else:
+			self.remote_received(node, packet, good)
+
+	# REMOTE
+
+	def sample(self, remote):
+		args = self.args
+		if self.now < args.duration:
+			ticks = self.period - SAMPLE_JITTER // 2 + \
+			        self.rng.randrange(SAMPLE_JITTER)
+			self.at(self.now + ticks / VLO_HZ, self.sample, remote)
+
+		# If the timer fires while the last exchange is still going, the
+		# next pass of the loop starts as soon as it is over
+		if remote.busy:
+			remote.pending = True
+		else:
+			self.take_sample(remote)
+
+	def take_sample(self, remote):
+		remote.busy = True
+		remote.seq = (remote.seq + 1) & 0xFF
+		remote.taken = self.now
+		remote.tries = 0
+		self.sent += 1
+		self.at(self.now + self.args.wake, self.send_sample, remote)
+
+	def send_sample(self, remote):
+		packet = Packet(remote, SAMPLE, remote.base, remote.seq, remote.taken)
+		self.send(packet, SAMPLE_LENGTH)
+
+	def sample_sent(self, remote):
+		self.listen(remote)
+		remote.token += 1
+		self.at(self.now + ACK_TIMEOUT / VLO_HZ, self.ack_timeout, remote,
+		        remote.token)
+
+	def remote_received(self, remote, packet, good):
+		if good and packet.kind == ACK and packet.dest is remote:
+			self.acked += 1
+			self.done(remote)
+		# Someone else's packet, keep listening
+
+	def ack_timeout(self, remote, token):
+		if token != remote.token:
+			return
+		if remote.tries < self.args.retries:
+			remote.tries += 1
+			self.deafen(remote)
+			backoff = self.rng.random() * self.args.backoff
+			self.at(self.now + backoff + self.args.wake, self.send_sample,
+			        remote)
+			return
+		self.done(remote)
+
+	def done(self, remote):
+		remote.token += 1
+		self.deafen(remote)
+		remote.busy = False
+		if remote.pending:
+			remote.pending = False
+			self.take_sample(remote)
+
+	# BASE
+
+	def base_received(self, base, packet, good):
+		args = self.args
+		self.deafen(base)
+
+		if not good or packet.kind != SAMPLE:
+			base.cpu += args.isr
+			self.at(self.now + args.isr, self.listen, base)
+			return
+
+		uart = RECORD_BYTES * UART_BYTE_S
+		base.cpu += args.isr + args.turnaround + uart
+
+		# A resend after a lost ACK repeats the last sequence number, the
+		# 8-bit counter wrapping around doesn't
+		if base.last.get(packet.sender.index) == packet.seq:
+			self.duplicates += 1
+		else:
+			base.last[packet.sender.index] = packet.seq
+			self.delivered += 1
+			self.latency.append(self.now + args.turnaround + uart - packet.taken)
+
+		ack = Packet(base, ACK, packet.sender, packet.seq, packet.taken)
+		self.at(self.now + args.isr + args.turnaround, self.send, ack,
+		        ACK_LENGTH)
+
+
+def percentile(values, pct):
+	if not values:
+		return float('nan')
+	values = sorted(values)
+	return values[min(len(values) - 1, int(len(values) * pct / 100.0))]
+
+
+def simulate(job):
+	args, nodes, period, seed = job
+	sim = Sim(args, nodes, period, seed)
+
+	start = time.time()
+	events = sim.run()
+	wall = max(time.time() - start, 1e-6)
+
+	simulated = sim.now
+	cpu = sum(base.cpu for base in sim.bases) / (simulated * len(sim.bases))
+	return {
+		'nodes': nodes,
+		'period': period,
+		'seed': seed,
+		'remotes': nodes,
+		'reachable': sum(1 for remote in sim.remotes
+		                 if dbm(sim.gain(remote, remote.base)) >=
+		                 args.sensitivity),
+		'sent': sim.sent,
+		'delivered': sim.delivered,
+		'duplicates': sim.duplicates,
+		'acked': sim.acked,
+		'latency': sim.latency,
+		'cpu': cpu,
+		'events': events,
+		'speed': simulated / wall,
+	}
+
+
+def main(argv):
+	parser = argparse.ArgumentParser(description='Multi-node RF simulation')
+	parser.add_argument('--nodes', type=int, nargs='+',
+	                    default=[10, 50, 100, 200])
+	parser.add_argument('--period', type=float, nargs='+',
+	                    default=[SAMPLE_PERIOD / VLO_HZ],
+	                    help='sample period in seconds')
+	parser.add_argument('--bases', type=int, default=1)
+	parser.add_argument('--duration', type=float, default=300.0,
+	                    help='simulated seconds')
+	parser.add_argument('--seeds', type=int, default=1,
+	                    help='runs per point, averaged')
+	parser.add_argument('--jobs', type=int, default=multiprocessing.cpu_count())
+	parser.add_argument('--sync-start', action='store_true',
+	                    help='power every REMOTE up at the same time')
+	parser.add_argument('--retries', type=int, default=0)
+	parser.add_argument('--backoff', type=float, default=0.2,
+	                    help='longest random wait before a retry, seconds')
+	radio = parser.add_argument_group('radio')
+	radio.add_argument('--radius', type=float, default=100.0,
+	                   help='REMOTEs are spread over a disc this wide, m')
+	radio.add_argument('--tx-power', type=float, default=0.0, help='dBm')
+	radio.add_argument('--loss-1m', type=float, default=40.0, help='dB')
+	radio.add_argument('--exponent', type=float, default=3.0)
+	radio.add_argument('--shadowing', type=float, default=4.0, help='dB')
+	radio.add_argument('--sensitivity', type=float, default=-104.0,
+	                   help='dBm')
+	radio.add_argument('--noise', type=float, default=-111.0, help='dBm')
+	radio.add_argument('--capture', type=float, default=7.0,
+	                   help='SINR a packet needs to get through, dB')
+	timing = parser.add_argument_group('timing, seconds')
+	timing.add_argument('--wake', type=float, default=0.001,
+	                    help='REMOTE radio wake to TX')
+	timing.add_argument('--isr', type=float, default=0.0001,
+	                    help='BASE packet interrupt')
+	timing.add_argument('--turnaround', type=float, default=0.0015,
+	                    help='BASE FIFO read and ACK write to TX')
+	args = parser.parse_args(argv[1:])
+
+	jobs = [(args, nodes, period, seed)
+	        for period in args.period
+	        for nodes in args.nodes
+	        for seed in range(1, args.seeds + 1)]
+
+	start = time.time()
+	if args.jobs > 1 and len(jobs) > 1:
+		pool = multiprocessing.Pool(min(args.jobs, len(jobs)))
+		results = pool.map(simulate, jobs, 1)
+		pool.close()
+	else:
+		results = [simulate(job) for job in jobs]
+
+	print('%6s %7s %7s %9s %7s %7s %7s %7s %7s %6s %9s' % ('nodes', 'period',
+	      'reach', 'delivered', 'acked', 'dups', 'p50 ms', 'p90 ms', 'p99 ms', 'cpu %',
+	      'x real'))
+	for point in range(0, len(results), args.seeds):
+		runs = results[point:point + args.seeds]
+		first = runs[0]
+		sent = float(sum(r['sent'] for r in runs)) or 1.0
+
+		def mean(name):
+			return sum(r[name] for r in runs) / len(runs)
+
+		# Percentiles over the samples of every seed together, so a seed
+		# with nothing delivered doesn't spoil the rest
+		latency = [value for r in runs for value in r['latency']]
+
+		print('%6d %7.2f %6.1f%% %8.1f%% %6.1f%% %7d %7.0f %7.0f %7.0f %6.1f '
+		      '%9.0f' %
+		      (first['nodes'], first['period'],
+		       100.0 * sum(r['reachable'] for r in runs) /
+		       sum(r['remotes'] for r in runs),
+		       100 * sum(r['delivered'] for r in runs) / sent,
+		       100 * sum(r['acked'] for r in runs) / sent,
+		       sum(r['duplicates'] for r in runs),
+		       1000 * percentile(latency, 50), 1000 * percentile(latency, 90),
+		       1000 * percentile(latency, 99),
+		       100 * mean('cpu'), mean('speed')))
+
+	sys.stderr.write('%d runs, %d events in %.1f s\n' % (len(results),
+	                 sum(r['events'] for r in results), time.time() - start))
+	return 0
+
+
+if __name__ == '__main__':
+	sys.exit(main(sys.argv))
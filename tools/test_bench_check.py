@@ -0,0 +1,75 @@
+#!/usr/bin/env python
+#******************************************************************************
+# test_bench_check.py
+#
+# Northern Arizona University
+#
+# Runs bench_check.py on logs shaped like the UART output of the benchmark
+# images:
+#
+#   python -m unittest discover -s tools
+#******************************************************************************
+
+import os
+import shutil
+import sys
+import tempfile
+import unittest
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import bench_check
+
+DRIVER = (b'{"bench":"burst_read","cycles":500,"spi":17,"uart":0,'
+          b'"airtime_us":0,"energy_uj":2,"stack":40,"isr_cycles":0}\r\n')
+
+# The BASE loop sends a REC_SAMPLE, with no line end of its own, just
+# before its result
+LOOP = (b'\xa5\x01\x11\x03\x7b\x00\x00\x00\x12\x34\x00\x56\x0a\x0d\x7b\x00'
+        b'\x01\x02\x03\x04\x05' +
+        b'{"bench":"base_loop","cycles":%d,"spi":40,"uart":21,'
+        b'"airtime_us":86671,"energy_uj":20,"stack":80,"isr_cycles":90}\r\n')
+
+
+class BenchCheckTest(unittest.TestCase):
+
+	def setUp(self):
+		self.dir = tempfile.mkdtemp()
+		self.baseline = os.path.join(self.dir, 'baseline.json')
+
+	def tearDown(self):
+		shutil.rmtree(self.dir)
+
+	def log(self, name, data):
+		path = os.path.join(self.dir, name)
+		with open(path, 'wb') as out:
+			out.write(data)
+		return path
+
+	def check(self, path, *options):
+		return bench_check.main(['bench_check.py', path, '--baseline',
+		                         self.baseline] + list(options))
+
+	def test_result_after_binary_record(self):
+		path = self.log('base.log', DRIVER + LOOP % 5000 + LOOP % 5100)
+		runs = bench_check.read_log(path)
+		self.assertEqual(sorted(runs), ['base_loop', 'burst_read'])
+		self.assertEqual(runs['base_loop']['cycles'], [5000, 5100])
+
+	def test_no_baseline_fails(self):
+		path = self.log('base.log', DRIVER + LOOP % 5000)
+		self.assertEqual(self.check(path), 1)
+
+	def test_regression_fails(self):
+		self.check(self.log('good.log', DRIVER + LOOP % 5000), '--record')
+		self.assertEqual(self.check(self.log('same.log', DRIVER + LOOP % 5200)),
+		                 0)
+		self.assertEqual(self.check(self.log('slow.log', DRIVER + LOOP % 6000)),
+		                 1)
+
+	def test_missing_benchmark_fails(self):
+		self.check(self.log('good.log', DRIVER + LOOP % 5000), '--record')
+		self.assertEqual(self.check(self.log('short.log', DRIVER)), 1)
+
+
+if __name__ == '__main__':
+	unittest.main()
@@ -0,0 +1,58 @@
+#!/usr/bin/env python
+#******************************************************************************
+# test_uart_replay.py
+#
+# Northern Arizona University
+#
+# Checks that records replayed into the pty come out the other side byte for
+# byte, the way the host and tools/analytics.py read them:
+#
+#   python -m unittest discover -s tools
+#******************************************************************************
+
+import os
+import select
+import sys
+import unittest
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from uart_replay import open_pty, split_records, REC_SYNC, REC_SAMPLE
+
+
+def frame(record_type, payload):
+	body = bytes([record_type, len(payload)]) + bytes(payload)
+	return bytes([REC_SYNC]) + body + bytes([sum(body) & 0xFF])
+
+
+class PtyTest(unittest.TestCase):
+
+	def test_control_bytes_pass_through(self):
+		# ^C, CR, DEL, ^V, LF, XON, XOFF, ^D and ^Z, which a pty in cooked
+		# mode would change or swallow
+		payload = [1, 0x03, 0x0D, 0x7F, 0x16, 0x0A, 0x11, 0x13, 0x04, 0x1A,
+		           0x00, 0xFF, 0x0D, 0x0A, 0x7F, 0x03, 0x16]
+		records = [frame(REC_SAMPLE, payload) for _ in range(50)]
+		sent = b''.join(records)
+
+		master, slave = open_pty()
+		reader = os.open(os.ttyname(slave), os.O_RDONLY | os.O_NOCTTY)
+		try:
+			os.write(master, sent)
+			received = b''
+			while len(received) < len(sent):
+				ready, _, _ = select.select([reader], [], [], 2)
+				if not ready:
+					break
+				received += os.read(reader, 4096)
+		finally:
+			os.close(reader)
+			os.close(slave)
+			os.close(master)
+
+		self.assertEqual(received, sent)
+		self.assertEqual([f for _, f in split_records([(0, received)])],
+		                 records)
+
+
+if __name__ == '__main__':
+	unittest.main()
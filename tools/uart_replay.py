@@ -0,0 +1,210 @@
+#!/usr/bin/env python
+#******************************************************************************
+# uart_replay.py
+#
+# Northern Arizona University
+#
+# Records what the BASE sends over the UART and plays it back into a pseudo
+# terminal, so the host decoder and storage can be run against real data
+# over and over, and faster than real time.
+#
+#   python tools/uart_replay.py record /dev/ttyACM0 base.cap
+#   python tools/uart_replay.py replay base.cap --speed 10
+#   python tools/uart_replay.py replay a.cap b.cap --copies 50 --speed 0
+#
+# A capture file is the header line CAPTURE_MAGIC followed by chunks, each a
+# little endian double (seconds since the recording started), a 32-bit byte
+# count, and the bytes as they came off the port.
+#
+# The replayer prints the name of the pty to point the host program at. It
+# cuts the stream into records (see src/record.h) and only ever writes whole
+# ones, so several captures can be merged in time order on the one pty. Each
+# copy of a capture has its node numbers moved up by --node-stride, so 50
+# copies of a one-node capture look like 50 nodes. --speed 0 sends as fast as
+# the reader takes it; the records/s at the end is the ingestion rate.
+#******************************************************************************
+
+import argparse
+import heapq
+import os
+import struct
+import sys
+import time
+import tty
+
+CAPTURE_MAGIC = b'EWSM-UART-CAPTURE 1\n'
+CHUNK_HEADER = struct.Struct('<dI')
+
+# From src/record.h
+REC_SYNC = 0xA5
+REC_SAMPLE = 0x01
+REC_WAVEFORM = 0x03
+REC_OVERHEAD = 4
+
+# Records whose first payload byte is the node
+NODE_RECORDS = (REC_SAMPLE, REC_WAVEFORM)
+
+BASE_BAUD = 9600
+
+
+def record(args):
+	try:
+		import serial
+	except ImportError:
+		sys.stderr.write('recording needs pyserial\n')
+		return 2
+
+	port = serial.Serial(args.port, args.baud, timeout=0.1)
+	out = open(args.capture, 'wb')
+	out.write(CAPTURE_MAGIC)
+
+	start = time.time()
+	total = 0
+	try:
+		while args.duration == 0 or time.time() - start < args.duration:
+			data = port.read(256)
+			if data:
+				out.write(CHUNK_HEADER.pack(time.time() - start, len(data)))
+				out.write(data)
+				total += len(data)
+	except KeyboardInterrupt:
+		pass
+
+	out.close()
+	sys.stderr.write('%d bytes in %.1f s\n' % (total, time.time() - start))
+	return 0
+
+
+def read_capture(path):
+	# Yields (time, bytes) for each chunk
+	data = open(path, 'rb').read()
+	if not data.startswith(CAPTURE_MAGIC):
+		raise ValueError('%s is not a capture file' % path)
+
+	offset = len(CAPTURE_MAGIC)
+	while offset + CHUNK_HEADER.size <= len(data):
+		stamp, length = CHUNK_HEADER.unpack_from(data, offset)
+		offset += CHUNK_HEADER.size
+		yield stamp, data[offset:offset + length]
+		offset += length
+
+
+def split_records(chunks):
+	# Yields (time, record) for each framed record with a good checksum, the
+	# time being that of the chunk its last byte came in. Bytes between
+	# records are dropped, as the host would.
+	pending = bytearray()
+	for stamp, data in chunks:
+		pending.extend(data)
+		while True:
+			start = pending.find(bytes([REC_SYNC]))
+			if start < 0:
+				del pending[:]
+				break
+			del pending[:start]
+			if len(pending) < 3:
+				break
+			length = pending[2] + REC_OVERHEAD
+			if len(pending) < length:
+				break
+			frame = bytes(pending[:length])
+			if sum(frame[1:-1]) & 0xFF == frame[-1]:
+				yield stamp, frame
+				del pending[:length]
+			else:
+				# Not a real sync byte, look for the next one
+				del pending[:1]
+
+
+def renumber(frame, offset):
+	# Moves the node in a record up by OFFSET, node 0 (the BASE) and 255
+	# (broadcast) excepted, and fixes up the checksum
+	if offset == 0 or frame[1] not in NODE_RECORDS or frame[3] in (0, 255):
+		return frame
+	frame = bytearray(frame)
+	frame[3] = (frame[3] - 1 + offset) % 254 + 1
+	frame[-1] = sum(frame[1:-1]) & 0xFF
+	return bytes(frame)
+
+
+def streams(paths, copies, stride):
+	# One time ordered record stream per copy of each capture
+	index = 0
+	for path in paths:
+		frames = list(split_records(read_capture(path)))
+		for copy in range(copies):
+			yield ((stamp, renumber(frame, index * stride))
+			       for stamp, frame in frames)
+			index += 1
+
+
+def open_pty():
+	# A pty in raw mode, so the line discipline passes every byte of the
+	# records through as is (no ^C, CR to LF, DEL or ^V handling). Set before
+	# a reader opens the slave.
+	master, slave = os.openpty()
+	tty.setraw(slave)
+	return master, slave
+
+
+def replay(args):
+	master, slave = open_pty()
+	sys.stderr.write('replaying on %s\n' % os.ttyname(slave))
+	if args.wait:
+		sys.stderr.write('press enter once the reader is running\n')
+		sys.stdin.readline()
+
+	merged = heapq.merge(*streams(args.captures, args.copies, args.node_stride),
+	                     key=lambda item: item[0])
+
+	start = time.time()
+	records = 0
+	total = 0
+	for stamp, frame in merged:
+		if args.speed > 0:
+			delay = stamp / args.speed - (time.time() - start)
+			if delay > 0:
+				time.sleep(delay)
+		os.write(master, frame)
+		records += 1
+		total += len(frame)
+
+	elapsed = max(time.time() - start, 1e-6)
+	sys.stderr.write('%d records, %d bytes in %.2f s: %.0f records/s, '
+	                 '%.1fx the %d baud link\n' %
+	                 (records, total, elapsed, records / elapsed,
+	                  total * 10 / elapsed / BASE_BAUD, BASE_BAUD))
+	return 0
+
+
+def main(argv):
+	parser = argparse.ArgumentParser(description='Record and replay BASE UART streams')
+	commands = parser.add_subparsers(dest='command')
+	commands.required = True
+
+	rec = commands.add_parser('record', help='record a serial port')
+	rec.add_argument('port')
+	rec.add_argument('capture')
+	rec.add_argument('--baud', type=int, default=BASE_BAUD)
+	rec.add_argument('--duration', type=float, default=0,
+	                 help='seconds to record, 0 until ctrl-c')
+	rec.set_defaults(run=record)
+
+	rep = commands.add_parser('replay', help='replay captures into a pty')
+	rep.add_argument('captures', nargs='+')
+	rep.add_argument('--speed', type=float, default=1,
+	                 help='times real time, 0 for as fast as possible')
+	rep.add_argument('--copies', type=int, default=1,
+	                 help='times to replay each capture at once')
+	rep.add_argument('--node-stride', type=int, default=16,
+	                 help='node number offset between copies')
+	rep.add_argument('--wait', action='store_true',
+	                 help='wait for enter before starting')
+	rep.set_defaults(run=replay)
+
+	args = parser.parse_args(argv[1:])
+	return args.run(args)
+
+
+if __name__ == '__main__':
+	sys.exit(main(sys.argv))